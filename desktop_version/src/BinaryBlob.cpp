@@ -14,9 +14,13 @@ binaryBlob::binaryBlob(void)
 {
 #ifdef VVV_COMPILEMUSIC
     numberofHeaders = 0;
+    SDL_zeroa(m_memblocks);
 #endif
     SDL_zeroa(m_headers);
-    SDL_zeroa(m_memblocks);
+    SDL_zeroa(m_offsets);
+    m_mapping = NULL;
+    m_mapping_size = 0;
+    SDL_zeroa(m_path);
 }
 
 #ifdef VVV_COMPILEMUSIC
@@ -87,6 +91,7 @@ bool binaryBlob::unPackBinary(const char* name)
 
 void binaryBlob::clear(void)
 {
+#ifdef VVV_COMPILEMUSIC
     for (size_t i = 0; i < SDL_arraysize(m_headers); i += 1)
     {
         if (m_memblocks[i] != NULL)
@@ -95,7 +100,16 @@ void binaryBlob::clear(void)
         }
     }
     SDL_zeroa(m_memblocks);
+#endif
+    if (m_mapping != NULL)
+    {
+        FILESYSTEM_unmapFile(m_mapping, m_mapping_size);
+        m_mapping = NULL;
+        m_mapping_size = 0;
+    }
     SDL_zeroa(m_headers);
+    SDL_zeroa(m_offsets);
+    SDL_zeroa(m_path);
 }
 
 int binaryBlob::getIndex(const char* _name)
@@ -120,14 +134,27 @@ int binaryBlob::getSize(int _index)
     return m_headers[_index].size;
 }
 
-char* binaryBlob::getAddress(int _index)
+SDL_RWops* binaryBlob::openTrack(int _index)
 {
-    if (!INBOUNDS_ARR(_index, m_memblocks))
+    if (!INBOUNDS_ARR(_index, m_headers) || !m_headers[_index].valid)
     {
-        vlog_error("getAddress() out-of-bounds!");
+        vlog_error("openTrack() out-of-bounds!");
         return NULL;
     }
-    return m_memblocks[_index];
+
+    if (m_mapping != NULL)
+    {
+        return SDL_RWFromConstMem(
+            m_mapping + m_offsets[_index],
+            m_headers[_index].size
+        );
+    }
+
+    return FILESYSTEM_openSliceRW(
+        m_path,
+        m_offsets[_index],
+        m_headers[_index].size
+    );
 }
 
 bool binaryBlob::nextExtra(size_t* start)
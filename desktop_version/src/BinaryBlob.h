@@ -4,6 +4,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/* Forward declaration */
+struct SDL_RWops;
+
 /* Laaaazyyyyyyy -flibit */
 // #define VVV_COMPILEMUSIC
 
@@ -52,7 +55,9 @@ public:
 
     bool nextExtra(size_t* start);
 
-    char* getAddress(int _index);
+    /* Returns a new SDL_RWops reading only the given track, or NULL.
+     * Nothing is read until the RWops is. Free it with SDL_RWclose(). */
+    SDL_RWops* openTrack(int _index);
 
     void clear(void);
 
@@ -60,9 +65,19 @@ public:
 
 #ifdef VVV_COMPILEMUSIC
     int numberofHeaders;
+    char* m_memblocks[max_headers];
 #endif
     resourceheader m_headers[max_headers];
-    char* m_memblocks[max_headers];
+
+    /* Byte offset of each track in the blob file */
+    int32_t m_offsets[max_headers];
+
+    /* If the blob sits in a real directory, it's memory-mapped here... */
+    const char* m_mapping;
+    size_t m_mapping_size;
+
+    /* ...otherwise we stream each track from this PhysFS path */
+    char m_path[256];
 };
 
 
@@ -0,0 +1,589 @@
+#include "Blit.h"
+
+#include <SDL.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLIT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BLIT_NEON
+#include <arm_neon.h>
+#endif
+
+enum BlitMode
+{
+    BLIT_COPY,
+    BLIT_BLEND,
+    BLIT_COLOURED,
+    BLIT_FILL
+};
+
+/* Same arithmetic as SDL's own ARGB8888 alpha blitter, so we don't drift from
+ * what SDL_BlitSurface() would have drawn */
+static inline Uint32 blend_pixel(const Uint32 s, const Uint32 d)
+{
+    const Uint32 a = s >> 24;
+    if (a == 0)
+    {
+        return d;
+    }
+    if (a == 255)
+    {
+        return s;
+    }
+
+    Uint32 result = ((d >> 24) * (255 - a) + a * 256) >> 8 << 24;
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        const Uint32 dc = (d >> shift) & 0xFF;
+        const Uint32 sc = (s >> shift) & 0xFF;
+        result |= ((dc * (256 - a) + sc * a) >> 8) << shift;
+    }
+    return result;
+}
+
+static void blend_row(Uint32* dst, const Uint32* src, const int w)
+{
+    int x = 0;
+
+#if defined(BLIT_SSE2)
+    /* 16 bits per channel, two pixels per register. Colour channels use
+     * weights (256 - a, a), alpha uses (255 - a, 256), and none of the sums
+     * can overflow. */
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alpha_weight = _mm_set_epi16(256, 0, 0, 0, 256, 0, 0, 0);
+    const __m128i dst_weight = _mm_set_epi16(255, 256, 256, 256, 255, 256, 256, 256);
+    const __m128i opaque = _mm_set1_epi32(255);
+
+    for (; x + 4 <= w; x += 4)
+    {
+        const __m128i s = _mm_loadu_si128((const __m128i*) (src + x));
+        const __m128i d = _mm_loadu_si128((const __m128i*) (dst + x));
+
+        __m128i halves[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            const __m128i s16 = i == 0 ? _mm_unpacklo_epi8(s, zero) : _mm_unpackhi_epi8(s, zero);
+            const __m128i d16 = i == 0 ? _mm_unpacklo_epi8(d, zero) : _mm_unpackhi_epi8(d, zero);
+            const __m128i a16 = _mm_shufflehi_epi16(
+                _mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)),
+                _MM_SHUFFLE(3, 3, 3, 3)
+            );
+            const __m128i ws = _mm_or_si128(_mm_and_si128(a16, rgb_mask), alpha_weight);
+            const __m128i wd = _mm_sub_epi16(dst_weight, a16);
+            halves[i] = _mm_srli_epi16(
+                _mm_add_epi16(_mm_mullo_epi16(d16, wd), _mm_mullo_epi16(s16, ws)),
+                8
+            );
+        }
+        __m128i result = _mm_packus_epi16(halves[0], halves[1]);
+
+        const __m128i a32 = _mm_srli_epi32(s, 24);
+        const __m128i clear = _mm_cmpeq_epi32(a32, zero);
+        const __m128i solid = _mm_cmpeq_epi32(a32, opaque);
+        result = _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, result));
+        result = _mm_or_si128(_mm_and_si128(solid, s), _mm_andnot_si128(solid, result));
+
+        _mm_storeu_si128((__m128i*) (dst + x), result);
+    }
+#elif defined(BLIT_NEON)
+    /* Same scheme as the SSE2 path above */
+    static const uint16_t rgb_mask_lanes[8] = {0xFFFF, 0xFFFF, 0xFFFF, 0, 0xFFFF, 0xFFFF, 0xFFFF, 0};
+    static const uint16_t alpha_weight_lanes[8] = {0, 0, 0, 256, 0, 0, 0, 256};
+    static const uint16_t dst_weight_lanes[8] = {256, 256, 256, 255, 256, 256, 256, 255};
+    const uint16x8_t rgb_mask = vld1q_u16(rgb_mask_lanes);
+    const uint16x8_t alpha_weight = vld1q_u16(alpha_weight_lanes);
+    const uint16x8_t dst_weight = vld1q_u16(dst_weight_lanes);
+
+    for (; x + 4 <= w; x += 4)
+    {
+        const uint32x4_t s = vld1q_u32(src + x);
+        const uint32x4_t d = vld1q_u32(dst + x);
+        const uint8x16_t s8 = vreinterpretq_u8_u32(s);
+        const uint8x16_t d8 = vreinterpretq_u8_u32(d);
+        const uint32x4_t a32 = vshrq_n_u32(s, 24);
+        const uint16x4_t a16 = vmovn_u32(a32);
+
+        const uint16x8_t a_lo = vcombine_u16(vdup_lane_u16(a16, 0), vdup_lane_u16(a16, 1));
+        const uint16x8_t a_hi = vcombine_u16(vdup_lane_u16(a16, 2), vdup_lane_u16(a16, 3));
+        const uint16x8_t s_lo = vmovl_u8(vget_low_u8(s8));
+        const uint16x8_t s_hi = vmovl_u8(vget_high_u8(s8));
+        const uint16x8_t d_lo = vmovl_u8(vget_low_u8(d8));
+        const uint16x8_t d_hi = vmovl_u8(vget_high_u8(d8));
+
+        const uint16x8_t lo = vshrq_n_u16(vaddq_u16(
+            vmulq_u16(d_lo, vsubq_u16(dst_weight, a_lo)),
+            vmulq_u16(s_lo, vorrq_u16(vandq_u16(a_lo, rgb_mask), alpha_weight))
+        ), 8);
+        const uint16x8_t hi = vshrq_n_u16(vaddq_u16(
+            vmulq_u16(d_hi, vsubq_u16(dst_weight, a_hi)),
+            vmulq_u16(s_hi, vorrq_u16(vandq_u16(a_hi, rgb_mask), alpha_weight))
+        ), 8);
+        uint32x4_t result = vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+
+        result = vbslq_u32(vceqq_u32(a32, vdupq_n_u32(0)), d, result);
+        result = vbslq_u32(vceqq_u32(a32, vdupq_n_u32(255)), s, result);
+
+        vst1q_u32(dst + x, result);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        dst[x] = blend_pixel(src[x], dst[x]);
+    }
+}
+
+template<int mode>
+struct RowBlitter;
+
+template<>
+struct RowBlitter<BLIT_COPY>
+{
+    static void run(Uint32* dst, const Uint32* src, const int w, const Uint32 /*colour*/)
+    {
+        SDL_memcpy(dst, src, w * sizeof(Uint32));
+    }
+};
+
+template<>
+struct RowBlitter<BLIT_BLEND>
+{
+    static void run(Uint32* dst, const Uint32* src, const int w, const Uint32 /*colour*/)
+    {
+        blend_row(dst, src, w);
+    }
+};
+
+template<>
+struct RowBlitter<BLIT_COLOURED>
+{
+    static void run(Uint32* dst, const Uint32* src, const int w, const Uint32 colour)
+    {
+        /* Colour a chunk at a time, then blend it as usual */
+        enum { CHUNK_SIZE = 64 };
+        Uint32 chunk[CHUNK_SIZE];
+
+        for (int x = 0; x < w; x += CHUNK_SIZE)
+        {
+            const int n = SDL_min(w - x, (int) CHUNK_SIZE);
+            for (int i = 0; i < n; ++i)
+            {
+                chunk[i] = BlitColourPixel(src[x + i], colour);
+            }
+            blend_row(dst + x, chunk, n);
+        }
+    }
+};
+
+template<int mode>
+static void blit_rect(
+    SDL_Surface* src,
+    const SDL_Rect& src_rect,
+    SDL_Surface* dest,
+    const SDL_Rect& dest_rect,
+    const Uint32 colour
+) {
+    const Uint8* src_row = (const Uint8*) src->pixels
+        + src_rect.y * src->pitch + src_rect.x * sizeof(Uint32);
+    Uint8* dest_row = (Uint8*) dest->pixels
+        + dest_rect.y * dest->pitch + dest_rect.x * sizeof(Uint32);
+
+    for (int y = 0; y < src_rect.h; ++y)
+    {
+        RowBlitter<mode>::run((Uint32*) dest_row, (const Uint32*) src_row, src_rect.w, colour);
+        src_row += src->pitch;
+        dest_row += dest->pitch;
+    }
+}
+
+static bool is_argb8888(const SDL_Surface* surface)
+{
+    return surface != NULL
+        && surface->pixels != NULL
+        && surface->format->format == SDL_PIXELFORMAT_ARGB8888
+        && !(surface->flags & SDL_RLEACCEL);
+}
+
+/* Returns the mode SDL_BlitSurface() would draw src with, or -1 if it's
+ * anything we don't handle here */
+static int get_mode(SDL_Surface* src)
+{
+    Uint32 key;
+    Uint8 alpha;
+    Uint8 r, g, b;
+    SDL_BlendMode blend;
+
+    if (SDL_GetColorKey(src, &key) == 0
+    || SDL_GetSurfaceAlphaMod(src, &alpha) != 0 || alpha != 255
+    || SDL_GetSurfaceColorMod(src, &r, &g, &b) != 0 || r != 255 || g != 255 || b != 255
+    || SDL_GetSurfaceBlendMode(src, &blend) != 0)
+    {
+        return -1;
+    }
+
+    switch (blend)
+    {
+    case SDL_BLENDMODE_NONE:
+        return BLIT_COPY;
+    case SDL_BLENDMODE_BLEND:
+        return BLIT_BLEND;
+    default:
+        return -1;
+    }
+}
+
+/* Clips the same way SDL_UpperBlit() does, including writing the result back
+ * to dest_rect. Returns false if there's nothing left to draw. */
+static bool clip_blit(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    SDL_Rect* src_out,
+    SDL_Rect* dest_out
+) {
+    SDL_Rect full_dest;
+    if (dest_rect == NULL)
+    {
+        full_dest.x = 0;
+        full_dest.y = 0;
+        full_dest.w = dest->w;
+        full_dest.h = dest->h;
+        dest_rect = &full_dest;
+    }
+
+    int srcx, srcy, w, h;
+    if (src_rect != NULL)
+    {
+        srcx = src_rect->x;
+        w = src_rect->w;
+        if (srcx < 0)
+        {
+            w += srcx;
+            dest_rect->x -= srcx;
+            srcx = 0;
+        }
+        w = SDL_min(w, src->w - srcx);
+
+        srcy = src_rect->y;
+        h = src_rect->h;
+        if (srcy < 0)
+        {
+            h += srcy;
+            dest_rect->y -= srcy;
+            srcy = 0;
+        }
+        h = SDL_min(h, src->h - srcy);
+    }
+    else
+    {
+        srcx = 0;
+        srcy = 0;
+        w = src->w;
+        h = src->h;
+    }
+
+    const SDL_Rect& clip = dest->clip_rect;
+    int dx = clip.x - dest_rect->x;
+    if (dx > 0)
+    {
+        w -= dx;
+        dest_rect->x += dx;
+        srcx += dx;
+    }
+    dx = dest_rect->x + w - clip.x - clip.w;
+    if (dx > 0)
+    {
+        w -= dx;
+    }
+
+    int dy = clip.y - dest_rect->y;
+    if (dy > 0)
+    {
+        h -= dy;
+        dest_rect->y += dy;
+        srcy += dy;
+    }
+    dy = dest_rect->y + h - clip.y - clip.h;
+    if (dy > 0)
+    {
+        h -= dy;
+    }
+
+    if (w <= 0 || h <= 0)
+    {
+        dest_rect->w = 0;
+        dest_rect->h = 0;
+        return false;
+    }
+
+    dest_rect->w = w;
+    dest_rect->h = h;
+
+    src_out->x = srcx;
+    src_out->y = srcy;
+    src_out->w = w;
+    src_out->h = h;
+    *dest_out = *dest_rect;
+    return true;
+}
+
+bool BlitPrepare(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    BlitOp* op
+) {
+    if (!is_argb8888(src) || !is_argb8888(dest) || src == dest)
+    {
+        return false;
+    }
+
+    const int mode = get_mode(src);
+    if (mode == -1)
+    {
+        return false;
+    }
+
+    SDL_zerop(op);
+    op->mode = mode;
+    op->src = src;
+    clip_blit(src, src_rect, dest, dest_rect, &op->src_rect, &op->dest_rect);
+    return true;
+}
+
+bool BlitPrepareColoured(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    const Uint32 colour,
+    BlitOp* op
+) {
+    /* BlitSurfaceColoured() draws from a fresh copy of src, so only the
+     * blend mode carries over, not colour keys or modulation */
+    SDL_BlendMode blend;
+    if (!is_argb8888(src) || !is_argb8888(dest) || src == dest
+    || SDL_GetSurfaceBlendMode(src, &blend) != 0 || blend != SDL_BLENDMODE_BLEND)
+    {
+        return false;
+    }
+
+    SDL_zerop(op);
+    op->mode = BLIT_COLOURED;
+    op->src = src;
+    op->colour = colour;
+    clip_blit(src, src_rect, dest, dest_rect, &op->src_rect, &op->dest_rect);
+    return true;
+}
+
+bool BlitPrepareFill(
+    SDL_Surface* dest,
+    const SDL_Rect* rect,
+    const Uint32 colour,
+    BlitOp* op
+) {
+    if (!is_argb8888(dest))
+    {
+        return false;
+    }
+
+    SDL_zerop(op);
+    op->mode = BLIT_FILL;
+    op->colour = colour;
+    if (rect == NULL)
+    {
+        op->dest_rect = dest->clip_rect;
+    }
+    else if (!SDL_IntersectRect(rect, &dest->clip_rect, &op->dest_rect))
+    {
+        SDL_zero(op->dest_rect);
+    }
+    return true;
+}
+
+void BlitExecute(
+    const BlitOp& op,
+    SDL_Surface* dest,
+    const int top,
+    const int bottom
+) {
+    const int first = SDL_max(op.dest_rect.y, top);
+    const int last = SDL_min(op.dest_rect.y + op.dest_rect.h, bottom);
+    if (op.dest_rect.w <= 0 || last <= first)
+    {
+        return;
+    }
+
+    SDL_Rect src_rect = op.src_rect;
+    SDL_Rect dest_rect = op.dest_rect;
+    src_rect.y += first - dest_rect.y;
+    src_rect.h = last - first;
+    dest_rect.y = first;
+    dest_rect.h = last - first;
+
+    switch (op.mode)
+    {
+    case BLIT_COPY:
+        blit_rect<BLIT_COPY>(op.src, src_rect, dest, dest_rect, 0);
+        break;
+    case BLIT_BLEND:
+        blit_rect<BLIT_BLEND>(op.src, src_rect, dest, dest_rect, 0);
+        break;
+    case BLIT_COLOURED:
+        blit_rect<BLIT_COLOURED>(op.src, src_rect, dest, dest_rect, op.colour);
+        break;
+    case BLIT_FILL:
+    {
+        Uint8* dest_row = (Uint8*) dest->pixels
+            + dest_rect.y * dest->pitch + dest_rect.x * sizeof(Uint32);
+        for (int y = 0; y < dest_rect.h; ++y)
+        {
+            SDL_memset4(dest_row, op.colour, dest_rect.w);
+            dest_row += dest->pitch;
+        }
+        break;
+    }
+    }
+}
+
+bool BlitFast(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect
+) {
+    BlitOp op;
+    if (!BlitPrepare(src, src_rect, dest, dest_rect, &op))
+    {
+        return false;
+    }
+    BlitExecute(op, dest, 0, dest->h);
+    return true;
+}
+
+bool BlitFastColoured(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    const Uint32 colour
+) {
+    BlitOp op;
+    if (!BlitPrepareColoured(src, src_rect, dest, dest_rect, colour, &op))
+    {
+        return false;
+    }
+    BlitExecute(op, dest, 0, dest->h);
+    return true;
+}
+
+int BlitPrepareRow(
+    SDL_Surface* const* row,
+    const int count,
+    const int step,
+    SDL_Surface* dest,
+    const int x,
+    const int y,
+    BlitOp* ops
+) {
+    int num_ops = 0;
+
+    if (count > BLIT_ROW_MAX)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (row[i] == NULL)
+        {
+            continue;
+        }
+
+        SDL_Rect rect = {x + i * step, y, 0, 0};
+        if (!BlitPrepare(row[i], NULL, dest, &rect, &ops[num_ops]))
+        {
+            return -1;
+        }
+        ++num_ops;
+    }
+
+    return num_ops;
+}
+
+void BlitExecuteRow(
+    const BlitOp* ops,
+    const int count,
+    SDL_Surface* dest
+) {
+    int top = dest->h;
+    int bottom = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (ops[i].dest_rect.w > 0 && ops[i].dest_rect.h > 0)
+        {
+            top = SDL_min(top, ops[i].dest_rect.y);
+            bottom = SDL_max(bottom, ops[i].dest_rect.y + ops[i].dest_rect.h);
+        }
+    }
+
+    for (int y = top; y < bottom; ++y)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            BlitExecute(ops[i], dest, y, y + 1);
+        }
+    }
+}
+
+bool BlitRow(
+    SDL_Surface* const* row,
+    const int count,
+    const int step,
+    SDL_Surface* dest,
+    const int x,
+    const int y
+) {
+    BlitOp ops[BLIT_ROW_MAX];
+    const int num_ops = BlitPrepareRow(row, count, step, dest, x, y, ops);
+    if (num_ops < 0)
+    {
+        return false;
+    }
+    BlitExecuteRow(ops, num_ops, dest);
+    return true;
+}
+
+void BlitReplace(
+    SDL_Surface* src,
+    SDL_Surface* dest,
+    const int x,
+    const int y
+) {
+    SDL_Rect rect = {x, y, 0, 0};
+
+    if (is_argb8888(src) && is_argb8888(dest) && src != dest)
+    {
+        SDL_Rect clipped_src;
+        SDL_Rect clipped_dest;
+        if (clip_blit(src, NULL, dest, &rect, &clipped_src, &clipped_dest))
+        {
+            blit_rect<BLIT_COPY>(src, clipped_src, dest, clipped_dest, 0);
+        }
+        return;
+    }
+
+    SDL_BlendMode blend;
+    if (SDL_GetSurfaceBlendMode(src, &blend) != 0)
+    {
+        return;
+    }
+    SDL_SetSurfaceBlendMode(src, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(src, NULL, dest, &rect);
+    SDL_SetSurfaceBlendMode(src, blend);
+}
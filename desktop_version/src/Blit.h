@@ -0,0 +1,129 @@
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <SDL.h>
+
+/* Blitters specialised for ARGB8888 onto ARGB8888, which is what everything
+ * we draw ends up as. They give the same pixels as SDL_BlitSurface() (and
+ * BlitSurfaceColoured()), including clipping and updating dest_rect, and
+ * return false without drawing anything if they can't handle the surfaces,
+ * so the caller can fall back to SDL. */
+
+/* What BlitSurfaceColoured() turns each pixel of its source into before
+ * blending it: colour's RGB, with the pixel's alpha scaled by colour's. Every
+ * coloured blit goes through this, so they all agree. */
+inline Uint32 BlitColourPixel(const Uint32 pixel, const Uint32 colour)
+{
+    const float div1 = (pixel >> 24) / 255.0f;
+    const float div2 = (colour >> 24) / 255.0f;
+    const Uint32 UseAlpha = (div1 * div2) * 255.0f;
+    return (colour & 0x00FFFFFF) | (UseAlpha << 24);
+}
+
+bool BlitFast(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect
+);
+
+bool BlitFastColoured(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    Uint32 colour
+);
+
+/* A blit or fill that's been checked and clipped but not drawn yet, so it can
+ * be drawn later, or a few rows at a time */
+struct BlitOp
+{
+    int mode;
+    SDL_Surface* src;
+    SDL_Rect src_rect;
+    SDL_Rect dest_rect;
+    Uint32 colour;
+};
+
+/* Same as BlitFast(), BlitFastColoured() and SDL_FillRect(), except they fill
+ * in op instead of drawing anything. dest_rect is still updated. */
+bool BlitPrepare(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    BlitOp* op
+);
+
+bool BlitPrepareColoured(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    Uint32 colour,
+    BlitOp* op
+);
+
+bool BlitPrepareFill(
+    SDL_Surface* dest,
+    const SDL_Rect* rect,
+    Uint32 colour,
+    BlitOp* op
+);
+
+/* Draws the part of op that lands on rows top to bottom - 1 of dest */
+void BlitExecute(
+    const BlitOp& op,
+    SDL_Surface* dest,
+    int top,
+    int bottom
+);
+
+/* The most tiles BlitPrepareRow() takes at once */
+#define BLIT_ROW_MAX 64
+
+/* BlitPrepare() for a row of count tiles, the first at (x, y) and each one
+ * step pixels to the right of the last. NULL entries are skipped. Fills in
+ * one op per tile and returns how many, or -1 if it can't handle all of them
+ * (or there are more than BLIT_ROW_MAX). */
+int BlitPrepareRow(
+    SDL_Surface* const* row,
+    int count,
+    int step,
+    SDL_Surface* dest,
+    int x,
+    int y,
+    BlitOp* ops
+);
+
+/* Draws count ops one row of dest at a time, going across all of them before
+ * moving down, instead of one op at a time */
+void BlitExecuteRow(
+    const BlitOp* ops,
+    int count,
+    SDL_Surface* dest
+);
+
+/* Same as BlitFast() on every tile in a row, as laid out for
+ * BlitPrepareRow(). Returns false without drawing anything if it can't do
+ * all of them. */
+bool BlitRow(
+    SDL_Surface* const* row,
+    int count,
+    int step,
+    SDL_Surface* dest,
+    int x,
+    int y
+);
+
+/* Copies src over dest at (x, y) as-is, alpha included, whatever src's blend
+ * mode is. Used to assemble prerendered surfaces out of tiles. */
+void BlitReplace(
+    SDL_Surface* src,
+    SDL_Surface* dest,
+    int x,
+    int y
+);
+
+#endif /* BLIT_H */
@@ -0,0 +1,469 @@
+#include "Capture.h"
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Vlogging.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAPTURE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CAPTURE_NEON
+#include <arm_neon.h>
+#endif
+
+#define CAPTURE_WIDTH 320
+#define CAPTURE_HEIGHT 240
+#define CAPTURE_FRAME_PIXELS (CAPTURE_WIDTH * CAPTURE_HEIGHT)
+/* A second or so of frames, to ride out the disk or the pipe stalling */
+#define CAPTURE_RING_FRAMES 64
+/* A second and a half of 44.1 kHz 16-bit stereo */
+#define CAPTURE_AUDIO_BYTES (1 << 18)
+
+static SDL_Thread* writer = NULL;
+static SDL_sem* wake = NULL;
+static SDL_atomic_t quitting;
+
+static FILE* video_file = NULL;
+static FILE* index_file = NULL;
+static FILE* audio_file = NULL;
+static bool y4m = false;
+
+/* Written by the game thread, read by the writer. The frames from
+ * frame_read up to frame_write are ready to go out, and one slot is always
+ * left empty so a full ring can be told apart from an empty one. The slot at
+ * frame_write belongs to the game thread until it's published. */
+static std::vector<Uint32> frames;
+static Uint64 frame_times[CAPTURE_RING_FRAMES];
+static SDL_atomic_t frame_read;
+static SDL_atomic_t frame_write;
+
+/* Only touched by the game thread */
+static bool frame_staged = false;
+static bool frame_wanted = false;
+static Uint32 frames_dropped = 0;
+static Uint64 start_time = 0;
+
+/* Same scheme in bytes, written by the audio thread */
+static std::vector<Uint8> audio;
+static SDL_atomic_t audio_read;
+static SDL_atomic_t audio_write;
+static SDL_atomic_t audio_dropped;
+
+/* Only touched by the writer */
+static std::vector<Uint8> planes;
+static Uint32 frames_written = 0;
+static bool write_failed = false;
+
+static Uint64 microseconds_since_start(void)
+{
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 elapsed = SDL_GetPerformanceCounter() - start_time;
+
+    /* Split up so this doesn't overflow after a few hours */
+    return elapsed / freq * 1000000 + elapsed % freq * 1000000 / freq;
+}
+
+static void write_out(FILE* file, const void* data, const size_t size)
+{
+    if (file == NULL || write_failed || size == 0)
+    {
+        return;
+    }
+
+    if (fwrite(data, 1, size, file) != size)
+    {
+        vlog_error("Could not write capture, stopping it here.");
+        write_failed = true;
+    }
+}
+
+/* Full-range BT.601, as Y4M's C420jpeg expects */
+static inline Uint8 luma(const Uint32 pixel)
+{
+    const Uint32 r = (pixel >> 16) & 0xFF;
+    const Uint32 g = (pixel >> 8) & 0xFF;
+    const Uint32 b = pixel & 0xFF;
+
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+static void luma_row(Uint8* dst, const Uint32* src, const int w)
+{
+    int x = 0;
+
+#if defined(CAPTURE_SSE2)
+    /* One pixel per 32-bit lane. Every weighted channel fits in 16 bits, so
+     * the 16-bit multiply is enough, and the high halves stay zero. */
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i weight_r = _mm_set1_epi32(77);
+    const __m128i weight_g = _mm_set1_epi32(150);
+    const __m128i weight_b = _mm_set1_epi32(29);
+    const __m128i round = _mm_set1_epi32(128);
+
+    for (; x + 8 <= w; x += 8)
+    {
+        __m128i halves[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            const __m128i p = _mm_loadu_si128((const __m128i*) (src + x + i * 4));
+            const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+            const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+            const __m128i b = _mm_and_si128(p, mask);
+            __m128i y = _mm_add_epi32(_mm_mullo_epi16(r, weight_r), _mm_mullo_epi16(g, weight_g));
+            y = _mm_add_epi32(y, _mm_add_epi32(_mm_mullo_epi16(b, weight_b), round));
+            halves[i] = _mm_srli_epi32(y, 8);
+        }
+        const __m128i y16 = _mm_packs_epi32(halves[0], halves[1]);
+        _mm_storel_epi64((__m128i*) (dst + x), _mm_packus_epi16(y16, y16));
+    }
+#elif defined(CAPTURE_NEON)
+    const uint32x4_t mask = vdupq_n_u32(0xFF);
+
+    for (; x + 8 <= w; x += 8)
+    {
+        const uint32x4_t lo = vld1q_u32(src + x);
+        const uint32x4_t hi = vld1q_u32(src + x + 4);
+        const uint16x8_t r = vcombine_u16(
+            vmovn_u32(vandq_u32(vshrq_n_u32(lo, 16), mask)),
+            vmovn_u32(vandq_u32(vshrq_n_u32(hi, 16), mask))
+        );
+        const uint16x8_t g = vcombine_u16(
+            vmovn_u32(vandq_u32(vshrq_n_u32(lo, 8), mask)),
+            vmovn_u32(vandq_u32(vshrq_n_u32(hi, 8), mask))
+        );
+        const uint16x8_t b = vcombine_u16(
+            vmovn_u32(vandq_u32(lo, mask)),
+            vmovn_u32(vandq_u32(hi, mask))
+        );
+        uint16x8_t y = vmulq_n_u16(r, 77);
+        y = vmlaq_n_u16(y, g, 150);
+        y = vmlaq_n_u16(y, b, 29);
+        vst1_u8(dst + x, vrshrn_n_u16(y, 8));
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        dst[x] = luma(src[x]);
+    }
+}
+
+static void chroma_rows(Uint8* u, Uint8* v, const Uint32* top, const Uint32* bottom, const int w)
+{
+    for (int x = 0; x < w / 2; ++x)
+    {
+        const Uint32 p[4] = {top[x * 2], top[x * 2 + 1], bottom[x * 2], bottom[x * 2 + 1]};
+        int r = 2;
+        int g = 2;
+        int b = 2;
+        for (int i = 0; i < 4; ++i)
+        {
+            r += (p[i] >> 16) & 0xFF;
+            g += (p[i] >> 8) & 0xFF;
+            b += p[i] & 0xFF;
+        }
+        r >>= 2;
+        g >>= 2;
+        b >>= 2;
+
+        u[x] = SDL_min((-43 * r - 85 * g + 128 * b + 32896) >> 8, 255);
+        v[x] = SDL_min((128 * r - 107 * g - 21 * b + 32896) >> 8, 255);
+    }
+}
+
+static void write_frame(const int slot)
+{
+    const Uint32* pixels = &frames[slot * CAPTURE_FRAME_PIXELS];
+
+    if (y4m)
+    {
+        static const char header[] = "FRAME\n";
+        const int chroma_w = CAPTURE_WIDTH / 2;
+        const int chroma_size = chroma_w * (CAPTURE_HEIGHT / 2);
+        Uint8* y = &planes[0];
+        Uint8* u = y + CAPTURE_FRAME_PIXELS;
+        Uint8* v = u + chroma_size;
+
+        for (int row = 0; row < CAPTURE_HEIGHT; ++row)
+        {
+            luma_row(y + row * CAPTURE_WIDTH, pixels + row * CAPTURE_WIDTH, CAPTURE_WIDTH);
+        }
+        for (int row = 0; row < CAPTURE_HEIGHT / 2; ++row)
+        {
+            chroma_rows(
+                u + row * chroma_w,
+                v + row * chroma_w,
+                pixels + row * 2 * CAPTURE_WIDTH,
+                pixels + (row * 2 + 1) * CAPTURE_WIDTH,
+                CAPTURE_WIDTH
+            );
+        }
+
+        write_out(video_file, header, sizeof(header) - 1);
+        write_out(video_file, &planes[0], planes.size());
+    }
+    else
+    {
+        write_out(video_file, pixels, CAPTURE_FRAME_PIXELS * sizeof(Uint32));
+    }
+
+    if (index_file != NULL && !write_failed)
+    {
+        fprintf(index_file, "%u %" SDL_PRIu64 "\n", frames_written, frame_times[slot]);
+    }
+    frames_written++;
+}
+
+static void drain_video(void)
+{
+    int read = SDL_AtomicGet(&frame_read);
+
+    while (read != SDL_AtomicGet(&frame_write))
+    {
+        write_frame(read);
+        read = (read + 1) % CAPTURE_RING_FRAMES;
+        SDL_AtomicSet(&frame_read, read);
+    }
+}
+
+static void drain_audio(void)
+{
+    const int read = SDL_AtomicGet(&audio_read);
+    const int write = SDL_AtomicGet(&audio_write);
+
+    if (read == write)
+    {
+        return;
+    }
+
+    if (write > read)
+    {
+        write_out(audio_file, &audio[read], write - read);
+    }
+    else
+    {
+        write_out(audio_file, &audio[read], CAPTURE_AUDIO_BYTES - read);
+        write_out(audio_file, &audio[0], write);
+    }
+    SDL_AtomicSet(&audio_read, write);
+}
+
+static int SDLCALL writer_main(void* unused)
+{
+    (void) unused;
+
+    while (true)
+    {
+        /* Check before draining, so nothing queued before quitting is
+         * left behind */
+        const bool last = SDL_AtomicGet(&quitting);
+
+        drain_video();
+        drain_audio();
+
+        if (last)
+        {
+            break;
+        }
+
+        SDL_SemWaitTimeout(wake, 100);
+    }
+
+    return 0;
+}
+
+static bool ends_with(const char* str, const char* suffix)
+{
+    const size_t str_len = SDL_strlen(str);
+    const size_t suffix_len = SDL_strlen(suffix);
+
+    return str_len >= suffix_len
+    && SDL_strcasecmp(str + str_len - suffix_len, suffix) == 0;
+}
+
+bool CAPTURE_init(const char* path)
+{
+    const std::string index_path = std::string(path) + ".idx";
+    const std::string audio_path = std::string(path) + ".pcm";
+
+    y4m = ends_with(path, ".y4m");
+
+    video_file = fopen(path, "wb");
+    index_file = fopen(index_path.c_str(), "w");
+    audio_file = fopen(audio_path.c_str(), "wb");
+    if (video_file == NULL || index_file == NULL || audio_file == NULL)
+    {
+        vlog_error("Could not open %s for capture.", path);
+        CAPTURE_quit();
+        return false;
+    }
+
+    if (y4m)
+    {
+        /* The frame rate here is nominal; the index has the real timing */
+        fprintf(
+            video_file,
+            "YUV4MPEG2 W%i H%i F30:1 Ip A1:1 C420jpeg\n",
+            CAPTURE_WIDTH,
+            CAPTURE_HEIGHT
+        );
+        planes.resize(CAPTURE_FRAME_PIXELS + CAPTURE_FRAME_PIXELS / 2);
+    }
+
+    frames.resize(CAPTURE_RING_FRAMES * CAPTURE_FRAME_PIXELS);
+    audio.resize(CAPTURE_AUDIO_BYTES);
+    SDL_AtomicSet(&frame_read, 0);
+    SDL_AtomicSet(&frame_write, 0);
+    SDL_AtomicSet(&audio_read, 0);
+    SDL_AtomicSet(&audio_write, 0);
+    SDL_AtomicSet(&audio_dropped, 0);
+    SDL_AtomicSet(&quitting, 0);
+    frame_staged = false;
+    frame_wanted = false;
+    frames_dropped = 0;
+    frames_written = 0;
+    write_failed = false;
+    start_time = SDL_GetPerformanceCounter();
+
+    wake = SDL_CreateSemaphore(0);
+    if (wake == NULL)
+    {
+        vlog_error("Could not set up capture: %s", SDL_GetError());
+        CAPTURE_quit();
+        return false;
+    }
+
+    writer = SDL_CreateThread(writer_main, "Capture", NULL);
+    if (writer == NULL)
+    {
+        vlog_error("Could not start capture thread: %s", SDL_GetError());
+        CAPTURE_quit();
+        return false;
+    }
+
+    vlog_info("Capturing to %s (%s)", path, y4m ? "Y4M" : "raw ARGB8888");
+    return true;
+}
+
+void CAPTURE_quit(void)
+{
+    if (writer != NULL)
+    {
+        SDL_AtomicSet(&quitting, 1);
+        SDL_SemPost(wake);
+        SDL_WaitThread(writer, NULL);
+        writer = NULL;
+
+        vlog_info(
+            "Captured %u frames, dropped %u frames and %i bytes of audio.",
+            frames_written,
+            frames_dropped,
+            SDL_AtomicGet(&audio_dropped)
+        );
+    }
+
+    if (wake != NULL)
+    {
+        SDL_DestroySemaphore(wake);
+        wake = NULL;
+    }
+
+#define X(FILE_POINTER) \
+    if (FILE_POINTER != NULL) \
+    { \
+        fclose(FILE_POINTER); \
+        FILE_POINTER = NULL; \
+    }
+
+    X(video_file);
+    X(index_file);
+    X(audio_file);
+
+#undef X
+
+    std::vector<Uint32>().swap(frames);
+    std::vector<Uint8>().swap(audio);
+    std::vector<Uint8>().swap(planes);
+}
+
+bool CAPTURE_active(void)
+{
+    return writer != NULL;
+}
+
+void CAPTURE_video(const void* pixels, const int pitch)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    frame_wanted = true;
+
+    const int write = SDL_AtomicGet(&frame_write);
+    if ((write + 1) % CAPTURE_RING_FRAMES == SDL_AtomicGet(&frame_read))
+    {
+        frame_staged = false;
+        return;
+    }
+
+    Uint32* slot = &frames[write * CAPTURE_FRAME_PIXELS];
+    const Uint8* row = (const Uint8*) pixels;
+    for (int y = 0; y < CAPTURE_HEIGHT; ++y)
+    {
+        SDL_memcpy(slot + y * CAPTURE_WIDTH, row, CAPTURE_WIDTH * sizeof(Uint32));
+        row += pitch;
+    }
+    frame_staged = true;
+}
+
+void CAPTURE_present(void)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    if (frame_staged)
+    {
+        const int write = SDL_AtomicGet(&frame_write);
+        frame_times[write] = microseconds_since_start();
+        SDL_AtomicSet(&frame_write, (write + 1) % CAPTURE_RING_FRAMES);
+        SDL_SemPost(wake);
+    }
+    else if (frame_wanted)
+    {
+        frames_dropped++;
+    }
+
+    frame_staged = false;
+    frame_wanted = false;
+}
+
+void CAPTURE_audio(const Uint8* stream, const int len)
+{
+    if (writer == NULL || len <= 0)
+    {
+        return;
+    }
+
+    const int read = SDL_AtomicGet(&audio_read);
+    const int write = SDL_AtomicGet(&audio_write);
+    const int space = (read - write - 1 + CAPTURE_AUDIO_BYTES) % CAPTURE_AUDIO_BYTES;
+    if (len > space)
+    {
+        /* Drop the whole buffer, so samples never get split */
+        SDL_AtomicAdd(&audio_dropped, len);
+        return;
+    }
+
+    const int first = SDL_min(len, CAPTURE_AUDIO_BYTES - write);
+    SDL_memcpy(&audio[write], stream, first);
+    SDL_memcpy(&audio[0], stream + first, len - first);
+    SDL_AtomicSet(&audio_write, (write + len) % CAPTURE_AUDIO_BYTES);
+    SDL_SemPost(wake);
+}
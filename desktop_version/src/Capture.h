@@ -0,0 +1,33 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <SDL.h>
+
+/* Records every presented frame (320x240, before scaling) and the mixed
+ * audio to disk on a background thread. The game and audio threads only
+ * ever copy into preallocated rings; if the writer falls behind, frames and
+ * audio are dropped and counted rather than waited on.
+ *
+ * Video goes to path, as Y4M if it ends in ".y4m" and as raw ARGB8888
+ * frames otherwise. Each written frame gets a line in path + ".idx" with its
+ * number and the microseconds since capture started, and audio goes to
+ * path + ".pcm" as raw samples in the mixer's output format. path can be a
+ * named pipe. */
+
+bool CAPTURE_init(const char* path);
+
+void CAPTURE_quit(void);
+
+bool CAPTURE_active(void);
+
+/* Called with whatever is about to be shown. If it's called more than once
+ * before CAPTURE_present(), the last call wins. */
+void CAPTURE_video(const void* pixels, int pitch);
+
+/* Called once the frame has actually been presented */
+void CAPTURE_present(void);
+
+/* Called from the audio thread with the final mix */
+void CAPTURE_audio(const Uint8* stream, int len);
+
+#endif /* CAPTURE_H */
@@ -3,6 +3,7 @@
 #define CL_DEFINITION
 #include "CustomLevels.h"
 
+#include <map>
 #include <physfs.h>
 #include <stdio.h>
 #include <string>
@@ -80,22 +81,11 @@ static bool compare_nocase (std::string first, std::string second)
         return false;
 }
 
-static void levelZipCallback(const char* filename)
-{
-    if (!FILESYSTEM_isFile(filename))
-    {
-        return;
-    }
-
-    if (endsWith(filename, ".zip"))
-    {
-        FILESYSTEM_loadZip(filename);
-    }
-}
-
 void customlevelclass::loadZips(void)
 {
-    FILESYSTEM_enumerateLevelDirFileNames(levelZipCallback);
+    const EngineProcessLock lock;
+
+    FILESYSTEM_scanLevelZips();
 }
 
 static void replace_all(std::string& str, const std::string& from, const std::string& to)
@@ -205,13 +195,14 @@ TAG_FINDER(find_website, "website")
 
 static void levelMetaDataCallback(const char* filename)
 {
-    extern customlevelclass cl;
+    extern ENGINE_LOCAL customlevelclass& cl;
     LevelMetaData temp;
     std::string filename_ = filename;
 
     if (!endsWith(filename, ".vvvvvv")
     || !FILESYSTEM_isFile(filename)
-    || FILESYSTEM_isMounted(filename))
+    || FILESYSTEM_isMounted(filename)
+    || FILESYSTEM_isLevelZipped(filename))
     {
         return;
     }
@@ -222,8 +213,194 @@ static void levelMetaDataCallback(const char* filename)
     }
 }
 
+static bool loadLevelMetaData(
+    const char* path,
+    const std::string& filename,
+    LevelMetaData& _data
+);
+
+/* Metadata of zipped levels, so listing them only needs their zip mounted if
+ * it changed since last time. Zips that are fine are kept in
+ * ZIP_METADATA_FILE too, so the next run doesn't have to mount them either. */
+struct ZipMetaData
+{
+    int64_t mtime;
+    bool valid;
+    bool seen;
+    LevelMetaData data;
+};
+
+static std::map<std::string, struct ZipMetaData> zipMetaData;
+static bool zipMetaDataLoaded = false;
+static bool zipMetaDataDirty = false;
+
+#define ZIP_METADATA_FILE "saves/levelzips.vvv"
+
+static void loadZipMetaData(void)
+{
+    tinyxml2::XMLDocument doc;
+    tinyxml2::XMLHandle hDoc(&doc);
+    tinyxml2::XMLElement* pElem;
+
+    zipMetaDataLoaded = true;
+
+    if (!FILESYSTEM_loadTiXml2Document(ZIP_METADATA_FILE, doc))
+    {
+        return;
+    }
+
+    if (doc.Error())
+    {
+        vlog_error("Error parsing levelzips.vvv: %s", doc.ErrorStr());
+        return;
+    }
+
+    for (pElem = hDoc
+        .FirstChildElement()
+        .FirstChildElement("Data")
+        .FirstChildElement("zip")
+        .ToElement();
+    pElem != NULL;
+    pElem = pElem->NextSiblingElement("zip"))
+    {
+        struct ZipMetaData cached;
+        const char* filename = pElem->Attribute("filename");
+        tinyxml2::XMLElement* subElem;
+
+        if (filename == NULL)
+        {
+            continue;
+        }
+
+        cached.mtime = pElem->Int64Attribute("mtime", -1);
+        cached.valid = true;
+        cached.seen = false;
+        cached.data.filename = filename;
+
+        for (subElem = pElem->FirstChildElement(); subElem != NULL; subElem = subElem->NextSiblingElement())
+        {
+            const char* pKey = subElem->Value();
+            const char* pText = subElem->GetText();
+            if (pText == NULL)
+            {
+                pText = "";
+            }
+
+            if (SDL_strcmp(pKey, "Creator") == 0)
+            {
+                cached.data.creator = pText;
+            }
+            else if (SDL_strcmp(pKey, "Title") == 0)
+            {
+                cached.data.title = pText;
+            }
+            else if (SDL_strcmp(pKey, "Desc1") == 0)
+            {
+                cached.data.Desc1 = pText;
+            }
+            else if (SDL_strcmp(pKey, "Desc2") == 0)
+            {
+                cached.data.Desc2 = pText;
+            }
+            else if (SDL_strcmp(pKey, "Desc3") == 0)
+            {
+                cached.data.Desc3 = pText;
+            }
+            else if (SDL_strcmp(pKey, "website") == 0)
+            {
+                cached.data.website = pText;
+            }
+        }
+
+        zipMetaData[filename] = cached;
+        FILESYSTEM_setLevelZipChecked(filename, cached.mtime);
+    }
+}
+
+static void saveZipMetaData(void)
+{
+    tinyxml2::XMLDocument doc;
+    tinyxml2::XMLElement* root;
+    tinyxml2::XMLElement* msgs;
+    std::map<std::string, struct ZipMetaData>::iterator it;
+
+    xml::update_declaration(doc);
+
+    root = xml::update_element(doc, "Levelzips");
+    xml::update_comment(root, " Level zips that were fine last time they were checked ");
+
+    msgs = xml::update_element(root, "Data");
+
+    for (it = zipMetaData.begin(); it != zipMetaData.end(); ++it)
+    {
+        tinyxml2::XMLElement* zip_el;
+        const LevelMetaData& data = it->second.data;
+
+        if (!it->second.valid)
+        {
+            continue;
+        }
+
+        zip_el = doc.NewElement("zip");
+        zip_el->SetAttribute("filename", it->first.c_str());
+        zip_el->SetAttribute("mtime", it->second.mtime);
+        xml::update_tag(zip_el, "Creator", data.creator.c_str());
+        xml::update_tag(zip_el, "Title", data.title.c_str());
+        xml::update_tag(zip_el, "Desc1", data.Desc1.c_str());
+        xml::update_tag(zip_el, "Desc2", data.Desc2.c_str());
+        xml::update_tag(zip_el, "Desc3", data.Desc3.c_str());
+        xml::update_tag(zip_el, "website", data.website.c_str());
+        msgs->LinkEndChild(zip_el);
+    }
+
+    if (!FILESYSTEM_saveTiXml2Document(ZIP_METADATA_FILE, doc))
+    {
+        vlog_error("Could not save levelzips.vvv");
+        return;
+    }
+
+    zipMetaDataDirty = false;
+}
+
+static void levelZipMetaDataCallback(
+    const char* filename,
+    const char* path,
+    const int64_t mtime
+) {
+    extern ENGINE_LOCAL customlevelclass& cl;
+    std::map<std::string, struct ZipMetaData>::iterator it;
+
+    it = zipMetaData.find(filename);
+    if (it == zipMetaData.end() || it->second.mtime != mtime)
+    {
+        struct ZipMetaData cached;
+        std::string filename_ = filename;
+        cached.mtime = mtime;
+        if (path != NULL)
+        {
+            /* It was just checked, and it's still mounted for that */
+            cached.valid = loadLevelMetaData(path, filename_, cached.data);
+        }
+        else
+        {
+            cached.valid = cl.getLevelMetaData(filename_, cached.data);
+        }
+        it = zipMetaData.insert(std::make_pair(filename_, cached)).first;
+        it->second = cached;
+        zipMetaDataDirty = true;
+    }
+
+    it->second.seen = true;
+
+    if (it->second.valid)
+    {
+        cl.ListOfMetaData.push_back(it->second.data);
+    }
+}
+
 void customlevelclass::getDirectoryData(void)
 {
+    const EngineProcessLock lock;
 
     ListOfMetaData.clear();
 
@@ -231,8 +408,42 @@ void customlevelclass::getDirectoryData(void)
 
     loadZips();
 
+    if (!zipMetaDataLoaded)
+    {
+        loadZipMetaData();
+    }
+
     FILESYSTEM_enumerateLevelDirFileNames(levelMetaDataCallback);
 
+    for (std::map<std::string, struct ZipMetaData>::iterator it = zipMetaData.begin(); it != zipMetaData.end(); ++it)
+    {
+        it->second.seen = false;
+    }
+
+    FILESYSTEM_enumerateLevelZips(levelZipMetaDataCallback);
+
+    /* Forget zips that have gone, or turned out not to be fine */
+    for (std::map<std::string, struct ZipMetaData>::iterator it = zipMetaData.begin(); it != zipMetaData.end();)
+    {
+        if (!it->second.seen)
+        {
+            zipMetaData.erase(it++);
+            zipMetaDataDirty = true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (zipMetaDataDirty)
+    {
+        saveZipMetaData();
+    }
+
+    /* Whichever level gets played mounts its own zip again */
+    FILESYSTEM_unmountLevelZips();
+
     for(size_t i = 0; i < ListOfMetaData.size(); i++)
     {
         for(size_t k = 0; k < ListOfMetaData.size(); k++)
@@ -247,12 +458,23 @@ void customlevelclass::getDirectoryData(void)
 }
 bool customlevelclass::getLevelMetaData(const std::string& _path, LevelMetaData& _data )
 {
+    const EngineProcessLock lock;
+    FILESYSTEM_mountLevelZip(_path.c_str());
+    return loadLevelMetaData(_path.c_str(), _path, _data);
+}
+
+/* Reads the metadata of the level file at path, which is listed as filename */
+static bool loadLevelMetaData(
+    const char* path,
+    const std::string& filename,
+    LevelMetaData& _data
+) {
     unsigned char *uMem;
-    FILESYSTEM_loadFileToMemory(_path.c_str(), &uMem, NULL, true);
+    FILESYSTEM_loadFileToMemory(path, &uMem, NULL, true);
 
     if (uMem == NULL)
     {
-        vlog_warn("Level %s not found :(", _path.c_str());
+        vlog_warn("Level %s not found :(", filename.c_str());
         return false;
     }
 
@@ -262,7 +484,7 @@ bool customlevelclass::getLevelMetaData(const std::string& _path, LevelMetaData&
 
     if (find_metadata(buf) == "")
     {
-        vlog_warn("Couldn't load metadata for %s", _path.c_str());
+        vlog_warn("Couldn't load metadata for %s", filename.c_str());
         return false;
     }
 
@@ -273,7 +495,7 @@ bool customlevelclass::getLevelMetaData(const std::string& _path, LevelMetaData&
     _data.Desc3 = find_desc3(buf);
     _data.website = find_website(buf);
 
-    _data.filename = _path;
+    _data.filename = filename;
     return true;
 }
 
@@ -281,44 +503,61 @@ void customlevelclass::reset(void)
 {
     version=2; //New smaller format change is 2
 
-    mapwidth=5;
-    mapheight=5;
-
-    title="Untitled Level";
-    creator="Unknown";
-
-    levmusic=0;
+    for (int i = 0; i < NUM_LEVEL_SECTIONS; i++)
+    {
+        resetsection(i);
+    }
 
-    customentities.clear();
-    levmusic=0;
+    SDL_zeroa(sectionhashes);
+}
 
-    for (int j = 0; j < maxheight; j++)
+void customlevelclass::resetsection(const int section)
+{
+    switch (section)
     {
-        for (int i = 0; i < maxwidth; i++)
+    case LevelSection_metadata:
+        title="Untitled Level";
+        creator="Unknown";
+        onewaycol_override = false;
+        break;
+    case LevelSection_map:
+        mapwidth=5;
+        mapheight=5;
+        levmusic=0;
+        break;
+    case LevelSection_contents:
+        SDL_zeroa(contents);
+        break;
+    case LevelSection_entities:
+        customentities.clear();
+        break;
+    case LevelSection_rooms:
+        for (int j = 0; j < maxheight; j++)
         {
-            roomproperties[i+(j*maxwidth)].tileset=0;
-            roomproperties[i+(j*maxwidth)].tilecol=(i+j)%32;
-            roomproperties[i+(j*maxwidth)].roomname="";
-            roomproperties[i+(j*maxwidth)].warpdir=0;
-            roomproperties[i+(j*maxwidth)].platx1=0;
-            roomproperties[i+(j*maxwidth)].platy1=0;
-            roomproperties[i+(j*maxwidth)].platx2=320;
-            roomproperties[i+(j*maxwidth)].platy2=240;
-            roomproperties[i+(j*maxwidth)].platv=4;
-            roomproperties[i+(j*maxwidth)].enemyx1=0;
-            roomproperties[i+(j*maxwidth)].enemyy1=0;
-            roomproperties[i+(j*maxwidth)].enemyx2=320;
-            roomproperties[i+(j*maxwidth)].enemyy2=240;
-            roomproperties[i+(j*maxwidth)].enemytype=0;
-            roomproperties[i+(j*maxwidth)].directmode=0;
+            for (int i = 0; i < maxwidth; i++)
+            {
+                roomproperties[i+(j*maxwidth)].tileset=0;
+                roomproperties[i+(j*maxwidth)].tilecol=(i+j)%32;
+                roomproperties[i+(j*maxwidth)].roomname="";
+                roomproperties[i+(j*maxwidth)].warpdir=0;
+                roomproperties[i+(j*maxwidth)].platx1=0;
+                roomproperties[i+(j*maxwidth)].platy1=0;
+                roomproperties[i+(j*maxwidth)].platx2=320;
+                roomproperties[i+(j*maxwidth)].platy2=240;
+                roomproperties[i+(j*maxwidth)].platv=4;
+                roomproperties[i+(j*maxwidth)].enemyx1=0;
+                roomproperties[i+(j*maxwidth)].enemyy1=0;
+                roomproperties[i+(j*maxwidth)].enemyx2=320;
+                roomproperties[i+(j*maxwidth)].enemyy2=240;
+                roomproperties[i+(j*maxwidth)].enemytype=0;
+                roomproperties[i+(j*maxwidth)].directmode=0;
+            }
         }
+        break;
+    case LevelSection_scripts:
+        script.clearcustom();
+        break;
     }
-
-    SDL_zeroa(contents);
-
-    script.clearcustom();
-
-    onewaycol_override = false;
 }
 
 const int* customlevelclass::loadlevel( int rxi, int ryi )
@@ -331,7 +570,7 @@ const int* customlevelclass::loadlevel( int rxi, int ryi )
     if(rxi>=mapwidth)rxi-=mapwidth;
     if(ryi>=mapheight)ryi-=mapheight;
 
-    static int result[1200];
+    static ENGINE_LOCAL int result[1200];
 
     for (int j = 0; j < 30; j++)
     {
@@ -794,7 +1033,7 @@ const RoomProperty* customlevelclass::getroomprop(const int rx, const int ry)
         return &roomproperties[idx];
     }
 
-    static RoomProperty blank;
+    static ENGINE_LOCAL RoomProperty blank;
     blank.tileset = 1;
     blank.directmode = 1;
     blank.roomname.clear();
@@ -917,50 +1156,80 @@ int customlevelclass::findwarptoken(int t)
 }
 
 
-bool customlevelclass::load(std::string& _path)
-{
-    tinyxml2::XMLDocument doc;
-    tinyxml2::XMLHandle hDoc(&doc);
-    tinyxml2::XMLElement* pElem;
+#define ALL_SECTIONS ((1 << NUM_LEVEL_SECTIONS) - 1)
 
-    reset();
-#ifndef NO_EDITOR
-    ed.reset();
-#endif
-
-    static const char *levelDir = "levels/";
-    if (_path.compare(0, SDL_strlen(levelDir), levelDir) != 0)
+static int getsection(const char* key)
+{
+    if (SDL_strcmp(key, "MetaData") == 0)
     {
-        _path = levelDir + _path;
+        return LevelSection_metadata;
     }
-
-    FILESYSTEM_unmountAssets();
-    if (game.cliplaytest && game.playassets != "")
+    if (SDL_strcmp(key, "mapwidth") == 0
+    || SDL_strcmp(key, "mapheight") == 0
+    || SDL_strcmp(key, "levmusic") == 0)
     {
-        MAYBE_FAIL(FILESYSTEM_mountAssets(game.playassets.c_str()));
+        return LevelSection_map;
     }
-    else
+    if (SDL_strcmp(key, "contents") == 0)
     {
-        MAYBE_FAIL(FILESYSTEM_mountAssets(_path.c_str()));
+        return LevelSection_contents;
     }
-
-    if (!FILESYSTEM_loadTiXml2Document(_path.c_str(), doc))
+    if (SDL_strcmp(key, "edEntities") == 0)
     {
-        vlog_warn("%s not found", _path.c_str());
-        goto fail;
+        return LevelSection_entities;
+    }
+    if (SDL_strcmp(key, "levelMetaData") == 0)
+    {
+        return LevelSection_rooms;
     }
+    if (SDL_strcmp(key, "script") == 0)
+    {
+        return LevelSection_scripts;
+    }
+    return -1;
+}
 
-    if (doc.Error())
+static void hashsections(tinyxml2::XMLDocument& doc, Uint64 hashes[NUM_LEVEL_SECTIONS])
+{
+    tinyxml2::XMLHandle hDoc(&doc);
+    tinyxml2::XMLElement* pElem;
+
+    for (int i = 0; i < NUM_LEVEL_SECTIONS; i++)
     {
-        vlog_error("Error parsing %s: %s", _path.c_str(), doc.ErrorStr());
-        goto fail;
+        hashes[i] = 0xCBF29CE484222325ULL;
     }
 
-#ifndef NO_EDITOR
-    ed.loaded_filepath = _path;
-#endif
+    for (pElem = hDoc
+        .FirstChildElement()
+        .FirstChildElement("Data")
+        .FirstChildElement()
+        .ToElement();
+    pElem != NULL;
+    pElem = pElem->NextSiblingElement())
+    {
+        const int section = getsection(pElem->Value());
+        if (section == -1)
+        {
+            continue;
+        }
 
-    version = 0;
+        /* FNV-1a over the element as it would be written back out, so any
+         * change to its attributes, text or children shows up */
+        tinyxml2::XMLPrinter printer(NULL, true);
+        pElem->Accept(&printer);
+        const char* text = printer.CStr();
+        for (int i = 0; text[i] != '\0'; i++)
+        {
+            hashes[section] ^= (unsigned char) text[i];
+            hashes[section] *= 0x100000001B3ULL;
+        }
+    }
+}
+
+void customlevelclass::loadsections(tinyxml2::XMLDocument& doc, const int sections)
+{
+    tinyxml2::XMLHandle hDoc(&doc);
+    tinyxml2::XMLElement* pElem;
 
     for (pElem = hDoc
         .FirstChildElement()
@@ -977,6 +1246,12 @@ bool customlevelclass::load(std::string& _path)
             pText = "";
         }
 
+        const int section = getsection(pKey);
+        if (section == -1 || !(sections & (1 << section)))
+        {
+            continue;
+        }
+
         if (SDL_strcmp(pKey, "MetaData") == 0)
         {
 
@@ -1211,7 +1486,7 @@ next:
         }
     }
 
-    if (mapwidth < maxwidth)
+    if ((sections & (1 << LevelSection_rooms)) && mapwidth < maxwidth)
     {
         /* Unscramble platv, since it was stored incorrectly
          * in 2.2 and previous... */
@@ -1249,6 +1524,58 @@ next:
             }
         }
     }
+}
+
+bool customlevelclass::load(std::string& _path)
+{
+    /* Holds on to the mounts until the level's read */
+    const EngineProcessLock lock;
+    tinyxml2::XMLDocument doc;
+
+    reset();
+#ifndef NO_EDITOR
+    ed.reset();
+#endif
+
+    static const char *levelDir = "levels/";
+    if (_path.compare(0, SDL_strlen(levelDir), levelDir) != 0)
+    {
+        _path = levelDir + _path;
+    }
+
+    /* If it's zipped, this is the only place it gets mounted for playing */
+    FILESYSTEM_mountLevelZip(_path.c_str());
+
+    /* Swaps out whatever assets are mounted, unless they're the same ones */
+    if (game.cliplaytest && game.playassets != "")
+    {
+        MAYBE_FAIL(FILESYSTEM_mountAssets(game.playassets.c_str()));
+    }
+    else
+    {
+        MAYBE_FAIL(FILESYSTEM_mountAssets(_path.c_str()));
+    }
+
+    if (!FILESYSTEM_loadTiXml2Document(_path.c_str(), doc))
+    {
+        vlog_warn("%s not found", _path.c_str());
+        goto fail;
+    }
+
+    if (doc.Error())
+    {
+        vlog_error("Error parsing %s: %s", _path.c_str(), doc.ErrorStr());
+        goto fail;
+    }
+
+#ifndef NO_EDITOR
+    ed.loaded_filepath = _path;
+#endif
+
+    version = 0;
+
+    loadsections(doc, ALL_SECTIONS);
+    hashsections(doc, sectionhashes);
 
 #ifndef NO_EDITOR
     ed.gethooks();
@@ -1262,6 +1589,59 @@ fail:
     return false;
 }
 
+int customlevelclass::reload(const std::string& _path)
+{
+    tinyxml2::XMLDocument doc;
+    Uint64 hashes[NUM_LEVEL_SECTIONS];
+    int changed = 0;
+
+    if (!FILESYSTEM_loadTiXml2Document(_path.c_str(), doc))
+    {
+        vlog_warn("%s not found", _path.c_str());
+        return -1;
+    }
+
+    if (doc.Error())
+    {
+        vlog_error("Error parsing %s: %s", _path.c_str(), doc.ErrorStr());
+        return -1;
+    }
+
+    hashsections(doc, hashes);
+    for (int i = 0; i < NUM_LEVEL_SECTIONS; i++)
+    {
+        if (hashes[i] != sectionhashes[i])
+        {
+            changed |= 1 << i;
+        }
+    }
+
+    /* The tiles and room properties are laid out by the map size */
+    if (changed & (1 << LevelSection_map))
+    {
+        changed = ALL_SECTIONS;
+    }
+
+    for (int i = 0; i < NUM_LEVEL_SECTIONS; i++)
+    {
+        if (changed & (1 << i))
+        {
+            resetsection(i);
+        }
+    }
+    loadsections(doc, changed);
+    SDL_memcpy(sectionhashes, hashes, sizeof(sectionhashes));
+
+#ifndef NO_EDITOR
+    if (changed & (1 << LevelSection_scripts))
+    {
+        ed.gethooks();
+    }
+#endif
+
+    return changed;
+}
+
 #ifndef NO_EDITOR
 bool customlevelclass::save(const std::string& _path)
 {
@@ -1748,7 +2128,7 @@ Uint32 customlevelclass::getonewaycol(void)
 
 static SDL_INLINE bool inbounds(const CustomEntity* entity)
 {
-    extern customlevelclass cl;
+    extern ENGINE_LOCAL customlevelclass& cl;
     return entity->x >= 0
     && entity->y >= 0
     && entity->x < cl.mapwidth * SCREEN_WIDTH_TILES
@@ -7,6 +7,14 @@
 #include <string>
 #include <vector>
 
+#include "EngineLocal.h"
+
+// Forward decl without including all of <tinyxml2.h>
+namespace tinyxml2
+{
+    class XMLDocument;
+}
+
 class CustomEntity
 {
 public:
@@ -61,7 +69,20 @@ struct LevelMetaData
 };
 
 
-extern std::vector<CustomEntity> customentities;
+extern ENGINE_LOCAL std::vector<CustomEntity>& customentities;
+
+/* The parts of a level file that customlevelclass::reload() can replace on
+ * their own. reload() returns them as bits, 1 << LevelSection_... */
+enum LevelSection
+{
+    LevelSection_metadata, /* <MetaData> */
+    LevelSection_map, /* mapwidth, mapheight and levmusic */
+    LevelSection_contents,
+    LevelSection_entities, /* <edEntities> */
+    LevelSection_rooms, /* <levelMetaData>, the room properties */
+    LevelSection_scripts,
+    NUM_LEVEL_SECTIONS
+};
 
 class customlevelclass
 {
@@ -116,6 +137,11 @@ public:
     int absfree(int x, int y);
 
     bool load(std::string& _path);
+    /* Reads the level at _path again, which should be the one that was last
+     * loaded, and replaces only the sections that changed since. Returns
+     * those sections, or -1 if the file couldn't be read, in which case
+     * nothing changes. Unlike load(), this doesn't touch assets. */
+    int reload(const std::string& _path);
 #ifndef NO_EDITOR
     bool save(const std::string& _path);
 #endif
@@ -146,10 +172,17 @@ public:
     Uint32 getonewaycol(const int rx, const int ry);
     Uint32 getonewaycol(void);
     bool onewaycol_override;
+
+private:
+    void resetsection(int section);
+    void loadsections(tinyxml2::XMLDocument& doc, int sections);
+
+    /* What each section looked like when it was last read from a file */
+    Uint64 sectionhashes[NUM_LEVEL_SECTIONS];
 };
 
 #ifndef CL_DEFINITION
-extern customlevelclass cl;
+extern ENGINE_LOCAL customlevelclass& cl;
 #endif
 
 #endif /* CUSTOMLEVELS_H */
@@ -12,7 +12,7 @@
  * include guard) and to do it without having to allocate memory at runtime.
  */
 
-static struct DEFER_Callback* head = NULL;
+static ENGINE_LOCAL struct DEFER_Callback* head = NULL;
 
 /* Add a callback. Don't call this directly; use the DEFER_CALLBACK macro. */
 void DEFER_add_callback(struct DEFER_Callback* callback)
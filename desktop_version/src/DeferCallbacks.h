@@ -1,6 +1,8 @@
 #ifndef DEFERCALLBACKS_H
 #define DEFERCALLBACKS_H
 
+#include "EngineLocal.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -19,7 +21,7 @@ void DEFER_execute_callbacks(void);
 #define DEFER_CALLBACK(FUNC) \
     do \
     { \
-        static struct DEFER_Callback callback = {FUNC, NULL}; \
+        static ENGINE_LOCAL struct DEFER_Callback callback = {FUNC, NULL}; \
         \
         DEFER_add_callback(&callback); \
     } while (0)
@@ -0,0 +1,449 @@
+#include "DrawList.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "Blit.h"
+#include "Vlogging.h"
+
+/* Below this many operations, waking the other threads costs more than it
+ * saves */
+#define DRAWLIST_MIN_PARALLEL_OPS 32
+
+struct Batch
+{
+    SDL_Surface* target;
+    std::vector<BlitOp> ops;
+    /* Only ever looked at by the main thread */
+    std::set<SDL_Surface*> sources;
+};
+
+static std::vector<SDL_Thread*> workers;
+static SDL_Thread* pipeline = NULL;
+static SDL_mutex* lock = NULL;
+static SDL_cond* start = NULL;
+static SDL_cond* done = NULL;
+static SDL_cond* pipeline_start = NULL;
+static SDL_cond* pipeline_done = NULL;
+
+/* Guarded by lock */
+static int generation = 0;
+static int remaining = 0;
+static bool pipeline_busy = false;
+static bool quitting = false;
+
+/* Whether anything gets recorded at all */
+static bool enabled = false;
+
+/* Main thread only */
+static Batch recording;
+/* Handed over by DRAWLIST_submit(). The main thread only looks at its
+ * sources until DRAWLIST_wait() says it's drawn. */
+static Batch submitted;
+static bool submit_pending = false;
+
+/* Only written by whoever's flushing while the workers are waiting. One
+ * flush at a time: the main thread only flushes what it's recording, and
+ * can only record once the pipeline has finished with the last batch. */
+static const Batch* drawing = NULL;
+static int band_height = 0;
+
+static void draw_band(const int band)
+{
+    const int top = band * band_height;
+    const int bottom = SDL_min(top + band_height, drawing->target->h);
+
+    for (size_t i = 0; i < drawing->ops.size(); i++)
+    {
+        BlitExecute(drawing->ops[i], drawing->target, top, bottom);
+    }
+}
+
+static int SDLCALL worker_main(void* data)
+{
+    const int band = (int) (size_t) data;
+    int seen;
+
+    SDL_LockMutex(lock);
+    seen = generation;
+    while (true)
+    {
+        while (!quitting && generation == seen)
+        {
+            SDL_CondWait(start, lock);
+        }
+        if (quitting)
+        {
+            break;
+        }
+        seen = generation;
+        SDL_UnlockMutex(lock);
+
+        draw_band(band);
+
+        SDL_LockMutex(lock);
+        if (--remaining == 0)
+        {
+            SDL_CondSignal(done);
+        }
+    }
+    SDL_UnlockMutex(lock);
+
+    return 0;
+}
+
+static void flush(const Batch& batch)
+{
+    if (batch.ops.empty())
+    {
+        return;
+    }
+
+    if (workers.empty() || batch.ops.size() < DRAWLIST_MIN_PARALLEL_OPS)
+    {
+        for (size_t i = 0; i < batch.ops.size(); i++)
+        {
+            BlitExecute(batch.ops[i], batch.target, 0, batch.target->h);
+        }
+    }
+    else
+    {
+        const int bands = workers.size() + 1;
+        drawing = &batch;
+        band_height = (batch.target->h + bands - 1) / bands;
+
+        SDL_LockMutex(lock);
+        remaining = workers.size();
+        generation++;
+        SDL_CondBroadcast(start);
+        SDL_UnlockMutex(lock);
+
+        draw_band(0);
+
+        SDL_LockMutex(lock);
+        while (remaining > 0)
+        {
+            SDL_CondWait(done, lock);
+        }
+        SDL_UnlockMutex(lock);
+
+        drawing = NULL;
+    }
+}
+
+static void flush_recording(void)
+{
+    flush(recording);
+    recording.ops.clear();
+    recording.sources.clear();
+}
+
+static int SDLCALL pipeline_main(void* data)
+{
+    (void) data;
+
+    SDL_LockMutex(lock);
+    while (true)
+    {
+        while (!quitting && !pipeline_busy)
+        {
+            SDL_CondWait(pipeline_start, lock);
+        }
+        if (quitting)
+        {
+            break;
+        }
+        SDL_UnlockMutex(lock);
+
+        flush(submitted);
+
+        SDL_LockMutex(lock);
+        pipeline_busy = false;
+        SDL_CondSignal(pipeline_done);
+    }
+    SDL_UnlockMutex(lock);
+
+    return 0;
+}
+
+void DRAWLIST_init(const int threads, const bool pipelined)
+{
+    if (threads < 2 && !pipelined)
+    {
+        return;
+    }
+
+    lock = SDL_CreateMutex();
+    start = SDL_CreateCond();
+    done = SDL_CreateCond();
+    pipeline_start = SDL_CreateCond();
+    pipeline_done = SDL_CreateCond();
+    if (lock == NULL
+    || start == NULL
+    || done == NULL
+    || pipeline_start == NULL
+    || pipeline_done == NULL)
+    {
+        vlog_warn("Could not set up render threads: %s", SDL_GetError());
+        DRAWLIST_quit();
+        return;
+    }
+
+    quitting = false;
+    for (int i = 1; i < threads; i++)
+    {
+        SDL_Thread* thread = SDL_CreateThread(worker_main, "DrawList", (void*) (size_t) i);
+        if (thread == NULL)
+        {
+            vlog_warn("Could not start render thread: %s", SDL_GetError());
+            break;
+        }
+        workers.push_back(thread);
+    }
+
+    if (pipelined)
+    {
+        pipeline = SDL_CreateThread(pipeline_main, "DrawListPipeline", NULL);
+        if (pipeline == NULL)
+        {
+            vlog_warn("Could not start pipelined render thread: %s", SDL_GetError());
+        }
+    }
+
+    if (workers.empty() && pipeline == NULL)
+    {
+        DRAWLIST_quit();
+        return;
+    }
+
+    enabled = true;
+    vlog_info(
+        "Rendering with %i threads%s",
+        (int) workers.size() + 1,
+        pipeline != NULL ? ", pipelined" : ""
+    );
+}
+
+void DRAWLIST_quit(void)
+{
+    DRAWLIST_end();
+    DRAWLIST_wait();
+    enabled = false;
+
+    if (!workers.empty() || pipeline != NULL)
+    {
+        SDL_LockMutex(lock);
+        quitting = true;
+        SDL_CondBroadcast(start);
+        SDL_CondSignal(pipeline_start);
+        SDL_UnlockMutex(lock);
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            SDL_WaitThread(workers[i], NULL);
+        }
+        workers.clear();
+
+        if (pipeline != NULL)
+        {
+            SDL_WaitThread(pipeline, NULL);
+            pipeline = NULL;
+        }
+    }
+
+    if (pipeline_done != NULL)
+    {
+        SDL_DestroyCond(pipeline_done);
+        pipeline_done = NULL;
+    }
+    if (pipeline_start != NULL)
+    {
+        SDL_DestroyCond(pipeline_start);
+        pipeline_start = NULL;
+    }
+    if (done != NULL)
+    {
+        SDL_DestroyCond(done);
+        done = NULL;
+    }
+    if (start != NULL)
+    {
+        SDL_DestroyCond(start);
+        start = NULL;
+    }
+    if (lock != NULL)
+    {
+        SDL_DestroyMutex(lock);
+        lock = NULL;
+    }
+}
+
+void DRAWLIST_begin(SDL_Surface* surface)
+{
+    DRAWLIST_end();
+    /* Whatever was submitted is most likely drawing onto this same surface,
+     * and everything after this assumes the pipeline is idle */
+    DRAWLIST_wait();
+
+    if (!enabled || surface == NULL)
+    {
+        return;
+    }
+
+    recording.target = surface;
+}
+
+void DRAWLIST_end(void)
+{
+    if (recording.target == NULL)
+    {
+        return;
+    }
+
+    flush_recording();
+    recording.target = NULL;
+}
+
+bool DRAWLIST_submit(void)
+{
+    if (pipeline == NULL || recording.target == NULL)
+    {
+        return false;
+    }
+
+    DRAWLIST_wait();
+
+    submitted.target = recording.target;
+    std::swap(submitted.ops, recording.ops);
+    std::swap(submitted.sources, recording.sources);
+    recording.target = NULL;
+
+    SDL_LockMutex(lock);
+    pipeline_busy = true;
+    SDL_CondSignal(pipeline_start);
+    SDL_UnlockMutex(lock);
+
+    submit_pending = true;
+    return true;
+}
+
+void DRAWLIST_wait(void)
+{
+    if (!submit_pending)
+    {
+        return;
+    }
+
+    SDL_LockMutex(lock);
+    while (pipeline_busy)
+    {
+        SDL_CondWait(pipeline_done, lock);
+    }
+    SDL_UnlockMutex(lock);
+
+    submit_pending = false;
+    submitted.target = NULL;
+    submitted.ops.clear();
+    submitted.sources.clear();
+}
+
+bool DRAWLIST_blit(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect
+) {
+    BlitOp op;
+    if (recording.target == NULL || dest != recording.target
+    || !BlitPrepare(src, src_rect, dest, dest_rect, &op))
+    {
+        return false;
+    }
+
+    recording.ops.push_back(op);
+    recording.sources.insert(src);
+    return true;
+}
+
+bool DRAWLIST_blitColoured(
+    SDL_Surface* src,
+    const SDL_Rect* src_rect,
+    SDL_Surface* dest,
+    SDL_Rect* dest_rect,
+    const Uint32 colour
+) {
+    BlitOp op;
+    if (recording.target == NULL || dest != recording.target
+    || !BlitPrepareColoured(src, src_rect, dest, dest_rect, colour, &op))
+    {
+        return false;
+    }
+
+    recording.ops.push_back(op);
+    recording.sources.insert(src);
+    return true;
+}
+
+bool DRAWLIST_fill(SDL_Surface* dest, const SDL_Rect* rect, const Uint32 colour)
+{
+    BlitOp op;
+    if (recording.target == NULL || dest != recording.target
+    || !BlitPrepareFill(dest, rect, colour, &op))
+    {
+        return false;
+    }
+
+    recording.ops.push_back(op);
+    return true;
+}
+
+bool DRAWLIST_blitRow(
+    SDL_Surface* const* row,
+    const int count,
+    const int step,
+    SDL_Surface* dest,
+    const int x,
+    const int y
+) {
+    BlitOp ops[BLIT_ROW_MAX];
+    if (recording.target == NULL || dest != recording.target)
+    {
+        return false;
+    }
+
+    const int num_ops = BlitPrepareRow(row, count, step, dest, x, y, ops);
+    if (num_ops < 0)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < num_ops; i++)
+    {
+        recording.ops.push_back(ops[i]);
+        recording.sources.insert(ops[i].src);
+    }
+    return true;
+}
+
+void DRAWLIST_sync(SDL_Surface* surface)
+{
+    if (submit_pending
+    && (surface == submitted.target
+    || submitted.sources.find(surface) != submitted.sources.end()))
+    {
+        DRAWLIST_wait();
+    }
+
+    if (recording.ops.empty())
+    {
+        return;
+    }
+
+    if (surface == recording.target
+    || recording.sources.find(surface) != recording.sources.end())
+    {
+        flush_recording();
+    }
+}
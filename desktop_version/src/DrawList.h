@@ -0,0 +1,54 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <SDL.h>
+
+/* Records blits and fills onto one surface instead of drawing them straight
+ * away, then draws them all at once with the surface split into horizontal
+ * bands, one per thread. Every pixel still sees the same operations in the
+ * same order, so the result is the same as drawing them one at a time.
+ *
+ * Anything that can't be recorded has to call DRAWLIST_sync() on the
+ * surfaces it touches first, which draws everything recorded so far if
+ * those surfaces are involved. */
+
+/* threads is the total number of threads to draw with, including the main
+ * thread. If pipelined, there's also a thread that DRAWLIST_submit() hands
+ * whole frames to. With neither of those, recording is left off. */
+void DRAWLIST_init(int threads, bool pipelined);
+
+void DRAWLIST_quit(void);
+
+/* Starts recording operations onto target */
+void DRAWLIST_begin(SDL_Surface* target);
+
+/* Draws everything recorded and stops recording */
+void DRAWLIST_end(void);
+
+/* Stops recording like DRAWLIST_end(), but has everything drawn on the
+ * pipeline thread instead, so the caller can get on with the next frame.
+ * Returns false, having done nothing, if there's no pipeline thread or
+ * nothing is being recorded. DRAWLIST_sync() and DRAWLIST_begin() wait for
+ * it to finish if they need to. */
+bool DRAWLIST_submit(void);
+
+/* Waits until whatever was submitted has been drawn */
+void DRAWLIST_wait(void);
+
+/* These record the operation and return true, or return false if they can't,
+ * in which case nothing is recorded and the caller should draw it itself */
+bool DRAWLIST_blit(SDL_Surface* src, const SDL_Rect* src_rect, SDL_Surface* dest, SDL_Rect* dest_rect);
+
+bool DRAWLIST_blitColoured(SDL_Surface* src, const SDL_Rect* src_rect, SDL_Surface* dest, SDL_Rect* dest_rect, Uint32 colour);
+
+bool DRAWLIST_fill(SDL_Surface* dest, const SDL_Rect* rect, Uint32 colour);
+
+/* A row of tiles, as for BlitRow() */
+bool DRAWLIST_blitRow(SDL_Surface* const* row, int count, int step, SDL_Surface* dest, int x, int y);
+
+/* Draws everything recorded if surface is the target or is being read by
+ * anything recorded. Call this before drawing to, reading from or freeing
+ * surface some other way. */
+void DRAWLIST_sync(SDL_Surface* surface);
+
+#endif /* DRAWLIST_H */
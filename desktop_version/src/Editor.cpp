@@ -295,7 +295,7 @@ static void fillboxabs( int x, int y, int x2, int y2, int c )
 
 static void editormenurender(int tr, int tg, int tb)
 {
-    extern editorclass ed;
+    extern ENGINE_LOCAL editorclass& ed;
     switch (game.currentmenuname)
     {
     case Menu::ed_settings:
@@ -474,7 +474,7 @@ static void editormenurender(int tr, int tg, int tb)
 
 void editorrender(void)
 {
-    extern editorclass ed;
+    extern ENGINE_LOCAL editorclass& ed;
     const RoomProperty* const room = cl.getroomprop(ed.levx, ed.levy);
 
     //Draw grid
@@ -522,29 +522,29 @@ void editorrender(void)
         }
     }
 
-    //Draw map, in function
+    //Draw map, in function, a row at a time
     int temp;
-    if(room->tileset==0 || room->tileset==10)
+    const int tileset = (room->tileset==0 || room->tileset==10) ? 0 : 1;
+    const Uint32 onewaycol = cl.getonewaycol();
+    for (int j = 0; j < 30; j++)
     {
-        for (int j = 0; j < 30; j++)
-        {
-            for (int i = 0; i < 40; i++)
-            {
-                temp=cl.gettile(ed.levx, ed.levy, i, j);
-                if(temp>0) graphics.drawtile(i*8,j*8,temp);
-            }
-        }
-    }
-    else
-    {
-        for (int j = 0; j < 30; j++)
+        SDL_Surface* row[40];
+        int generation;
+
+        /* Tinting a tile can free ones tinted earlier in the row, so start
+         * the row again if that happens */
+        do
         {
+            generation = graphics.tinted_generation;
             for (int i = 0; i < 40; i++)
             {
                 temp=cl.gettile(ed.levx, ed.levy, i, j);
-                if(temp>0) graphics.drawtile2(i*8,j*8,temp);
+                row[i] = temp>0 ? graphics.getforetile(tileset, temp, 0, onewaycol) : NULL;
             }
         }
+        while (generation != graphics.tinted_generation);
+
+        BlitSurfaceRow(row, SDL_arraysize(row), 8, graphics.backBuffer, 0, j*8);
     }
 
     //Edge tile fix
@@ -584,8 +584,6 @@ void editorrender(void)
 
     // Special case for drawing gray entities
     bool custom_gray = room->tileset == 3 && room->tilecol == 6;
-    colourTransform gray_ct;
-    gray_ct.colour = 0xFFFFFFFF;
 
     // Draw entities backward to remain accurate with ingame
     for (int i = customentities.size() - 1; i >= 0; i--)
@@ -621,7 +619,7 @@ void editorrender(void)
                 drawRect.x += tpoint.x;
                 drawRect.y += tpoint.y;
                 for (int j = 0; j < 4; j++) {
-                    if (custom_gray) BlitSurfaceTinted(graphics.entcolours[obj.customplatformtile],NULL, graphics.backBuffer, &drawRect, gray_ct);
+                    if (custom_gray) BlitSurfaceStandard(graphics.get_tinted(graphics.entcolours[obj.customplatformtile], 0xFFFFFFFF), NULL, graphics.backBuffer, &drawRect);
                     else BlitSurfaceStandard(graphics.entcolours[obj.customplatformtile],NULL, graphics.backBuffer, &drawRect);
                     drawRect.x += 8;
                 }
@@ -654,7 +652,7 @@ void editorrender(void)
                     drawRect.x += tpoint.x;
                     drawRect.y += tpoint.y;
                     for (int j = 0; j < 4; j++) {
-                        if (custom_gray) BlitSurfaceTinted(graphics.entcolours[obj.customplatformtile],NULL, graphics.backBuffer, &drawRect, gray_ct);
+                        if (custom_gray) BlitSurfaceStandard(graphics.get_tinted(graphics.entcolours[obj.customplatformtile], 0xFFFFFFFF), NULL, graphics.backBuffer, &drawRect);
                         else BlitSurfaceStandard(graphics.entcolours[obj.customplatformtile],NULL, graphics.backBuffer, &drawRect);
                         drawRect.x += 8;
                     }
@@ -682,7 +680,7 @@ void editorrender(void)
                 drawRect.x += tpoint.x;
                 drawRect.y += tpoint.y;
                 for (int j = 0; j < 4; j++) {
-                    if (custom_gray) BlitSurfaceTinted(graphics.entcolours[obj.customplatformtile],NULL, graphics.backBuffer, &drawRect, gray_ct);
+                    if (custom_gray) BlitSurfaceStandard(graphics.get_tinted(graphics.entcolours[obj.customplatformtile], 0xFFFFFFFF), NULL, graphics.backBuffer, &drawRect);
                     else BlitSurfaceStandard(graphics.entcolours[obj.customplatformtile],NULL, graphics.backBuffer, &drawRect);
                     drawRect.x += 8;
                 }
@@ -1545,7 +1543,7 @@ void editorrender(void)
 
 void editorrenderfixed(void)
 {
-    extern editorclass ed;
+    extern ENGINE_LOCAL editorclass& ed;
     const RoomProperty* const room = cl.getroomprop(ed.levx, ed.levy);
     graphics.updatetitlecolours();
 
@@ -1698,7 +1696,7 @@ void editorrenderfixed(void)
 
 void editorlogic(void)
 {
-    extern editorclass ed;
+    extern ENGINE_LOCAL editorclass& ed;
     //Misc
     help.updateglow();
 
@@ -1741,7 +1739,7 @@ static void nextbgcolor(void)
 
 static void editormenuactionpress(void)
 {
-    extern editorclass ed;
+    extern ENGINE_LOCAL editorclass& ed;
     switch (game.currentmenuname)
     {
     case Menu::ed_desc:
@@ -1913,7 +1911,7 @@ static void editormenuactionpress(void)
 
 void editorinput(void)
 {
-    extern editorclass ed;
+    extern ENGINE_LOCAL editorclass& ed;
     if (graphics.fademode == 3 /* fading out */)
     {
         return;
@@ -4,6 +4,7 @@
 #define EDITOR_H
 
 #include "CustomLevels.h"
+#include "EngineLocal.h"
 
 #include <SDL.h>
 #include <string>
@@ -181,7 +182,7 @@ void editorlogic(void);
 void editorinput(void);
 
 #ifndef ED_DEFINITION
-extern editorclass ed;
+extern ENGINE_LOCAL editorclass& ed;
 #endif
 
 #endif /* EDITOR_H */
@@ -0,0 +1,436 @@
+#include "Engine.h"
+
+#include "DeferCallbacks.h"
+#include "Input.h"
+#include "Logic.h"
+#include "preloader.h"
+#include "Render.h"
+#include "RenderFixed.h"
+
+EngineContext::EngineContext(void)
+{
+    time_ = 0;
+    timePrev = 0;
+    accumulator = 0;
+    f_time = 0;
+    f_timePrev = 0;
+
+    gamestate_funcs = NULL;
+    num_gamestate_funcs = 0;
+    gamestate_func_index = -1;
+    unfocused_func_index = 0; // This does not get incremented on start, do NOT use -1!
+    active_funcs = NULL;
+    num_active_funcs = NULL;
+    active_func_index = NULL;
+    increment_func_index = NULL;
+    meta_func_index = 0;
+}
+
+static ENGINE_LOCAL EngineContext instance;
+
+/* Binding a reference to a static object is constant initialization, so
+ * these are usable before any constructor runs, same as the globals were.
+ * Thread local ones are bound (and instance constructed) on a thread's first
+ * use of any of them instead. */
+ENGINE_LOCAL EngineContext& engine = instance;
+
+ENGINE_LOCAL scriptclass& script = instance.script;
+
+#ifndef NO_CUSTOM_LEVELS
+ENGINE_LOCAL std::vector<CustomEntity>& customentities = instance.customentities;
+ENGINE_LOCAL customlevelclass& cl = instance.cl;
+# ifndef NO_EDITOR
+ENGINE_LOCAL editorclass& ed = instance.ed;
+# endif
+#endif
+
+ENGINE_LOCAL UtilityClass& help = instance.help;
+ENGINE_LOCAL Graphics& graphics = instance.graphics;
+ENGINE_LOCAL musicclass& music = instance.music;
+ENGINE_LOCAL Game& game = instance.game;
+ENGINE_LOCAL KeyPoll& key = instance.key;
+ENGINE_LOCAL mapclass& map = instance.map;
+ENGINE_LOCAL entityclass& obj = instance.obj;
+ENGINE_LOCAL Screen& gameScreen = instance.gameScreen;
+
+#ifdef ENGINE_PER_THREAD
+static SDL_SpinLock process_lock_init = 0;
+static SDL_mutex* process_lock = NULL;
+
+void ENGINE_lock_process(void)
+{
+    SDL_AtomicLock(&process_lock_init);
+    if (process_lock == NULL)
+    {
+        process_lock = SDL_CreateMutex();
+    }
+    SDL_AtomicUnlock(&process_lock_init);
+
+    SDL_LockMutex(process_lock);
+}
+
+void ENGINE_unlock_process(void)
+{
+    SDL_UnlockMutex(process_lock);
+}
+#endif
+
+static void runscript(void)
+{
+    script.run();
+}
+
+static void teleportermodeinput(void)
+{
+    if (game.useteleporter)
+    {
+        teleporterinput();
+    }
+    else
+    {
+        script.run();
+        gameinput();
+    }
+}
+
+/* Only gets used in EDITORMODE. I assume the compiler will optimize this away
+ * if this is a NO_CUSTOM_LEVELS or NO_EDITOR build
+ */
+static void flipmodeoff(void)
+{
+    graphics.flipmode = false;
+}
+
+static void focused_begin(void)
+{
+    map.nexttowercolour_set = false;
+}
+
+static void focused_end(void)
+{
+    game.gameclock();
+    music.processmusic();
+    graphics.processfade();
+}
+
+const struct ImplFunc* ENGINE_get_gamestate_funcs(
+    const int gamestate,
+    int* num_implfuncs
+) {
+    switch (gamestate)
+    {
+
+#define FUNC_LIST_BEGIN(GAMESTATE) \
+    case GAMESTATE: \
+    { \
+        static const struct ImplFunc implfuncs[] = { \
+            {Func_fixed, focused_begin},
+
+#define FUNC_LIST_END \
+            {Func_fixed, focused_end} \
+        }; \
+        *num_implfuncs = SDL_arraysize(implfuncs); \
+        return implfuncs; \
+    }
+
+    FUNC_LIST_BEGIN(GAMEMODE)
+        {Func_fixed, runscript},
+        {Func_fixed, gamerenderfixed},
+        {Func_delta, gamerender},
+        {Func_input, gameinput},
+        {Func_fixed, gamelogic},
+    FUNC_LIST_END
+
+    FUNC_LIST_BEGIN(TITLEMODE)
+        {Func_input, titleinput},
+        {Func_fixed, titlerenderfixed},
+        {Func_delta, titlerender},
+        {Func_fixed, titlelogic},
+    FUNC_LIST_END
+
+    FUNC_LIST_BEGIN(MAPMODE)
+        {Func_fixed, maprenderfixed},
+        {Func_delta, maprender},
+        {Func_input, mapinput},
+        {Func_fixed, maplogic},
+    FUNC_LIST_END
+
+    FUNC_LIST_BEGIN(TELEPORTERMODE)
+        {Func_fixed, teleporterrenderfixed},
+        {Func_delta, teleporterrender},
+        {Func_input, teleportermodeinput},
+        {Func_fixed, maplogic},
+    FUNC_LIST_END
+
+    FUNC_LIST_BEGIN(GAMECOMPLETE)
+        {Func_fixed, gamecompleterenderfixed},
+        {Func_delta, gamecompleterender},
+        {Func_input, gamecompleteinput},
+        {Func_fixed, gamecompletelogic},
+    FUNC_LIST_END
+
+    FUNC_LIST_BEGIN(GAMECOMPLETE2)
+        {Func_delta, gamecompleterender2},
+        {Func_input, gamecompleteinput2},
+        {Func_fixed, gamecompletelogic2},
+    FUNC_LIST_END
+
+#if !defined(NO_CUSTOM_LEVELS) && !defined(NO_EDITOR)
+    FUNC_LIST_BEGIN(EDITORMODE)
+        {Func_fixed, flipmodeoff},
+        {Func_input, editorinput},
+        {Func_fixed, editorrenderfixed},
+        {Func_delta, editorrender},
+        {Func_fixed, editorlogic},
+    FUNC_LIST_END
+#endif
+
+    FUNC_LIST_BEGIN(PRELOADER)
+        {Func_input, preloaderinput},
+        {Func_fixed, preloaderrenderfixed},
+        {Func_delta, preloaderrender},
+    FUNC_LIST_END
+
+#undef FUNC_LIST_END
+#undef FUNC_LIST_BEGIN
+
+    }
+
+    SDL_assert(0 && "Invalid gamestate!");
+    return NULL;
+}
+
+enum IndexCode ENGINE_increment_gamestate_func_index(void)
+{
+    engine.gamestate_func_index++;
+
+    if (engine.gamestate_func_index == engine.num_gamestate_funcs)
+    {
+        /* Reached the end of current gamestate order.
+         * Re-fetch for new order if gamestate changed.
+         */
+        engine.gamestate_funcs = ENGINE_get_gamestate_funcs(
+            game.gamestate,
+            &engine.num_gamestate_funcs
+        );
+
+        /* Also run callbacks that were deferred to end of func sequence. */
+        DEFER_execute_callbacks();
+
+        engine.gamestate_func_index = 0;
+
+        return Index_end;
+    }
+
+    return Index_none;
+}
+
+void ENGINE_begin(void)
+{
+    engine.gamestate_funcs = ENGINE_get_gamestate_funcs(
+        game.gamestate,
+        &engine.num_gamestate_funcs
+    );
+    engine.gamestate_func_index = -1;
+
+    ENGINE_step();
+}
+
+void ENGINE_step(void)
+{
+    ENGINE_increment_gamestate_func_index();
+    graphics.renderfixedpost();
+
+    /* Same as fixedloop() in main.cpp, minus polling */
+    while (engine.gamestate_funcs[engine.gamestate_func_index].type != Func_delta)
+    {
+        const struct ImplFunc* implfunc = &engine.gamestate_funcs[engine.gamestate_func_index];
+
+        if (implfunc->type != Func_null && implfunc->func != NULL)
+        {
+            implfunc->func();
+        }
+
+        if (ENGINE_increment_gamestate_func_index() == Index_end)
+        {
+            /* What loop_end() does that isn't about the window or audio */
+            key.linealreadyemptykludge = false;
+        }
+    }
+
+    graphics.renderfixedpre();
+}
+
+#if !defined(NO_CUSTOM_LEVELS)
+bool ENGINE_find_level(const std::string& filename)
+{
+    LevelMetaData meta;
+
+    game.levelpage = 0;
+    game.playcustomlevel = 0;
+    game.menustart = true;
+
+    if (!cl.getLevelMetaData(filename, meta))
+    {
+        cl.loadZips();
+        if (!cl.getLevelMetaData(filename, meta))
+        {
+            return false;
+        }
+    }
+    cl.ListOfMetaData.clear();
+    cl.ListOfMetaData.push_back(meta);
+
+    game.loadcustomlevelstats();
+    game.customleveltitle = cl.ListOfMetaData[game.playcustomlevel].title;
+    game.customlevelfilename = cl.ListOfMetaData[game.playcustomlevel].filename;
+    return true;
+}
+
+bool ENGINE_start_playtest(const std::string& filename, const bool at_position)
+{
+    if (!ENGINE_find_level(filename))
+    {
+        return false;
+    }
+
+    game.cliplaytest = at_position;
+    if (at_position)
+    {
+        script.startgamemode(23);
+    }
+    else
+    {
+        script.startgamemode(22);
+    }
+
+    graphics.fademode = 0;
+    return true;
+}
+
+bool ENGINE_parse_int(const std::string& text, int* value)
+{
+    char* end;
+    const long parsed = SDL_strtol(text.c_str(), &end, 10);
+
+    if (text.empty() || *end != '\0')
+    {
+        return false;
+    }
+    *value = (int) parsed;
+    return true;
+}
+
+static bool is_extra_key(const std::string& name, const char* const* extra_keys)
+{
+    if (extra_keys == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; extra_keys[i] != NULL; i++)
+    {
+        if (name == extra_keys[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ENGINE_parse_playtest(
+    const std::string& line,
+    const char* const* extra_keys,
+    PlaytestRequest* request,
+    std::string* error
+) {
+    size_t start = 0;
+
+    request->level.clear();
+    request->assets.clear();
+    request->has_position = false;
+    request->x = 0;
+    request->y = 0;
+    request->rx = 0;
+    request->ry = 0;
+    request->gc = 0;
+    request->music = 0;
+    request->extra.clear();
+
+    while (start < line.size())
+    {
+        size_t end = line.find(' ', start);
+        if (end == std::string::npos)
+        {
+            end = line.size();
+        }
+        const std::string pair = line.substr(start, end - start);
+        start = end + 1;
+        if (pair.empty())
+        {
+            continue;
+        }
+
+        const size_t equals = pair.find('=');
+        if (equals == std::string::npos)
+        {
+            *error = "expected key=value, got " + pair;
+            return false;
+        }
+        const std::string name = pair.substr(0, equals);
+        const std::string value = pair.substr(equals + 1);
+
+        int* number = NULL;
+        if (is_extra_key(name, extra_keys))
+        {
+            request->extra.push_back(std::make_pair(name, value));
+        }
+        else if (name == "level") request->level = value;
+        else if (name == "assets") request->assets = value;
+        else if (name == "music") number = &request->music;
+        else if (name == "x") number = &request->x;
+        else if (name == "y") number = &request->y;
+        else if (name == "rx") number = &request->rx;
+        else if (name == "ry") number = &request->ry;
+        else if (name == "gc") number = &request->gc;
+        else
+        {
+            *error = "unknown key " + name;
+            return false;
+        }
+
+        if (number != NULL)
+        {
+            if (!ENGINE_parse_int(value, number))
+            {
+                *error = "bad number for " + name;
+                return false;
+            }
+            /* Music on its own doesn't make it start anywhere else */
+            if (number != &request->music)
+            {
+                request->has_position = true;
+            }
+        }
+    }
+
+    if (request->level.empty())
+    {
+        *error = "no level";
+        return false;
+    }
+    return true;
+}
+
+bool ENGINE_start_playtest(const PlaytestRequest& request)
+{
+    game.playassets = request.assets.empty() ? "" : "levels/" + request.assets + ".vvvvvv";
+    game.playx = request.x;
+    game.playy = request.y;
+    game.playrx = request.rx;
+    game.playry = request.ry;
+    game.playgc = request.gc;
+    game.playmusic = request.music;
+
+    return ENGINE_start_playtest("levels/" + request.level + ".vvvvvv", request.has_position);
+}
+#endif
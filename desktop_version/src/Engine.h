@@ -0,0 +1,157 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <SDL.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CustomLevels.h"
+#include "Editor.h"
+#include "EngineLocal.h"
+#include "Entity.h"
+#include "Game.h"
+#include "Graphics.h"
+#include "KeyPoll.h"
+#include "Map.h"
+#include "Music.h"
+#include "Screen.h"
+#include "Script.h"
+#include "UtilityClass.h"
+
+enum FuncType
+{
+    Func_null,
+    Func_fixed,
+    Func_input,
+    Func_delta
+};
+
+struct ImplFunc
+{
+    enum FuncType type;
+    void (*func)(void);
+};
+
+enum IndexCode
+{
+    Index_none,
+    Index_end
+};
+
+/* Everything that makes up the running game, in one place, so it can be
+ * reset, copied or inspected as a whole. The old globals (game, graphics,
+ * map, obj and so on) are references into the current instance, engine, so
+ * existing code doesn't have to change.
+ *
+ * In the executable there's only ever one of these. With ENGINE_PER_THREAD
+ * (libvvvvvv), engine and the references are ENGINE_LOCAL, so each thread
+ * gets its own instance the first time it touches any of them, and keeps it
+ * until the thread exits. */
+struct EngineContext
+{
+    EngineContext(void);
+
+    /* These are constructed in this order, the same order they used to be
+     * defined in main.cpp */
+    scriptclass script;
+#ifndef NO_CUSTOM_LEVELS
+    std::vector<CustomEntity> customentities;
+    customlevelclass cl;
+# ifndef NO_EDITOR
+    editorclass ed;
+# endif
+#endif
+    UtilityClass help;
+    Graphics graphics;
+    musicclass music;
+    Game game;
+    KeyPoll key;
+    mapclass map;
+    entityclass obj;
+    Screen gameScreen;
+
+    /* Main loop timing, in ticks */
+    volatile Uint64 time_;
+    volatile Uint64 timePrev;
+    volatile Uint32 accumulator;
+    volatile Uint64 f_time;
+    volatile Uint64 f_timePrev;
+
+    /* Where the main loop is in its function lists */
+    const struct ImplFunc* gamestate_funcs;
+    int num_gamestate_funcs;
+    int gamestate_func_index;
+    int unfocused_func_index;
+    const struct ImplFunc** active_funcs;
+    int* num_active_funcs;
+    int* active_func_index;
+    enum IndexCode (*increment_func_index)(void);
+    int meta_func_index;
+};
+
+extern ENGINE_LOCAL EngineContext& engine;
+
+/* The functions each gamestate runs every frame, in order. Shared by the main
+ * loop and libvvvvvv, so they both step the game the same way. */
+const struct ImplFunc* ENGINE_get_gamestate_funcs(int gamestate, int* num_implfuncs);
+
+/* Moves engine.gamestate_func_index on by one. At the end of the list, picks
+ * up any change in gamestate, runs deferred callbacks and returns Index_end. */
+enum IndexCode ENGINE_increment_gamestate_func_index(void);
+
+/* For running the game without the main loop, one fixed frame at a time,
+ * with whatever input is already in key.keymap and nothing drawn.
+ * ENGINE_begin() picks up game.gamestate's functions and runs up to the first
+ * render function, like the main loop's first fixed step; ENGINE_step() then
+ * runs from one render function to the next. */
+void ENGINE_begin(void);
+void ENGINE_step(void);
+
+#if !defined(NO_CUSTOM_LEVELS)
+/* Sets up the level at filename (e.g. "levels/foo.vvvvvv") to be started with
+ * script.startgamemode(22), or 23 from a given position, the same way -playing
+ * does. Returns false if it isn't there. */
+bool ENGINE_find_level(const std::string& filename);
+
+/* Finds the level and starts playing it straight away, from its start point
+ * or, if at_position, from game.playx, playy, playrx, playry and playgc (and
+ * with game.playmusic and game.playassets). Returns false if it isn't there. */
+bool ENGINE_start_playtest(const std::string& filename, bool at_position);
+
+/* A playtest asked for by another program, as one line of space-separated
+ * key=value pairs:
+ *   level=NAME               the custom level to play, as for -playing
+ *                            (required)
+ *   x= y= rx= ry= gc=        where to start, as for -playx and friends
+ *   music= assets=NAME       as for -playmusic and -playassets; only used
+ *                            along with a start position */
+struct PlaytestRequest
+{
+    std::string level;
+    std::string assets;
+    bool has_position;
+    int x, y, rx, ry, gc;
+    int music;
+    /* The keys the caller asked to handle itself, in order */
+    std::vector<std::pair<std::string, std::string> > extra;
+};
+
+/* A whole decimal number and nothing else */
+bool ENGINE_parse_int(const std::string& text, int* value);
+
+/* Fills in request from line. Keys in extra_keys (a NULL-terminated list, or
+ * NULL) go in request->extra as they are; any other key it doesn't know is an
+ * error. On failure, returns false and says why in error. */
+bool ENGINE_parse_playtest(
+    const std::string& line,
+    const char* const* extra_keys,
+    PlaytestRequest* request,
+    std::string* error
+);
+
+/* ENGINE_start_playtest() for a parsed request */
+bool ENGINE_start_playtest(const PlaytestRequest& request);
+#endif
+
+#endif /* ENGINE_H */
@@ -0,0 +1,49 @@
+#ifndef ENGINELOCAL_H
+#define ENGINELOCAL_H
+
+/* Marks state that belongs to one running game: the engine globals, and the
+ * file statics the game changes as it runs. libvvvvvv is built with
+ * ENGINE_PER_THREAD, which makes these thread local, so every thread gets a
+ * game of its own. Everywhere else there's only the one game, and they're
+ * ordinary globals.
+ *
+ * Process-wide things (SDL, PhysFS, SDL_mixer, and caches of what's loaded
+ * from them) aren't marked. */
+#if !defined(ENGINE_PER_THREAD)
+# define ENGINE_LOCAL
+#elif defined(__cplusplus)
+# define ENGINE_LOCAL thread_local
+#elif defined(_MSC_VER)
+# define ENGINE_LOCAL __declspec(thread)
+#else
+# define ENGINE_LOCAL __thread
+#endif
+
+#ifdef __cplusplus
+/* Held while the game changes something process-wide as it runs, like what's
+ * mounted or the sound cache. It's recursive, and it only does anything with
+ * ENGINE_PER_THREAD. */
+# ifdef ENGINE_PER_THREAD
+void ENGINE_lock_process(void);
+void ENGINE_unlock_process(void);
+# else
+inline void ENGINE_lock_process(void) {}
+inline void ENGINE_unlock_process(void) {}
+# endif
+
+/* Holds ENGINE_lock_process() until the end of the scope */
+struct EngineProcessLock
+{
+    EngineProcessLock(void)
+    {
+        ENGINE_lock_process();
+    }
+
+    ~EngineProcessLock(void)
+    {
+        ENGINE_unlock_process();
+    }
+};
+#endif
+
+#endif /* ENGINELOCAL_H */
@@ -24,37 +24,56 @@ public:
     bool ishumanoid(void);
 
 public:
+    /* Everything the per-frame sweeps (gamelogic, updateentitylogic,
+     * entitymapcollision, entitycollisioncheck, drawentities) read or write
+     * goes up here, so they mostly touch the start of each entity rather than
+     * all of it. The rest is only used by the updateentities/animateentities
+     * switches and is ordered as before. Keep new fields out of this block
+     * unless they're used every frame for every entity. */
+
     //Fundamentals
     bool invis;
-    int type, size, tile, rule;
-    int state, statedelay;
-    int behave, animate;
-    float para;
-    int life, colour;
+    bool isplatform;
+    bool gravity;
+    bool harmful;
+    int type, size, rule;
 
     //Position and velocity
+    int xp, yp;
     int oldxp, oldyp;
     float ax, ay, vx, vy;
-    int cx, cy, w, h;
     float newxp, newyp;
-    bool isplatform;
-    int x1,y1,x2,y2;
+    int cx, cy, w, h;
+
     //Collision Rules
     int onentity;
-    bool harmful;
     int onwall, onxwall, onywall;
 
     //Platforming specific
-    bool gravity;
     int onground, onroof;
+
+    //Drawing
+    int lerpoldxp, lerpoldyp;
+    int tile;
+    int drawframe;
+    int colour;
+    Uint32 realcol;
+
+    /* Everything else */
+
+    //Fundamentals
+    int state, statedelay;
+    int behave, animate;
+    float para;
+    int life;
+
+    //Position and velocity
+    int x1,y1,x2,y2;
+
     //Animation
-    int framedelay, drawframe, walkingframe, dir, actionframe;
+    int framedelay, walkingframe, dir, actionframe;
     int collisionframedelay, collisiondrawframe, collisionwalkingframe;
     int visualonground, visualonroof;
-    int yp;int xp;
-
-    Uint32 realcol;
-    int lerpoldxp, lerpoldyp;
 };
 
 #endif /* ENT_H */
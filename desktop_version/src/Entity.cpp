@@ -2,6 +2,8 @@
 #include "Entity.h"
 
 #include <SDL.h>
+#include <algorithm>
+#include <functional>
 
 #include "CustomLevels.h"
 #include "Game.h"
@@ -86,9 +88,22 @@ void entityclass::init(void)
     SDL_memset(collect, false, sizeof(collect));
     SDL_memset(customcollect, false, sizeof(customcollect));
 
+    /* Enough for any room, including the Super Gravitron */
+    entities.reserve(128);
+    liveentities.reserve(128);
+
     k = 0;
 }
 
+static bool isdisabled(const entclass& entity)
+{
+    return entity.invis
+    && entity.size == -1
+    && entity.type == -1
+    && entity.rule == -1
+    && !entity.isplatform;
+}
+
 void entityclass::resetallflags(void)
 {
     SDL_memset(flags, false, sizeof(flags));
@@ -1123,9 +1138,91 @@ bool entityclass::disableentity(int t)
     entities[t].rule = -1;
     entities[t].isplatform = false;
 
+    std::vector<int>::iterator live = std::lower_bound(
+        liveentities.begin(),
+        liveentities.end(),
+        t
+    );
+    if (live != liveentities.end() && *live == t)
+    {
+        liveentities.erase(live);
+        freeentities.push_back(t);
+        std::push_heap(freeentities.begin(), freeentities.end(), std::greater<int>());
+    }
+
     return true;
 }
 
+/* Actually remove entity t, shifting all the ones after it down. Only cheap
+ * for the last entity, which is the only way gotoroom() uses it. */
+void entityclass::removeentity(int t)
+{
+    if (!INBOUNDS_VEC(t, entities))
+    {
+        vlog_error("removeentity() out-of-bounds!");
+        return;
+    }
+
+    const bool last = t == (int) entities.size() - 1;
+    entities.erase(entities.begin() + t);
+
+    std::vector<int>::iterator live = std::lower_bound(
+        liveentities.begin(),
+        liveentities.end(),
+        t
+    );
+    if (live != liveentities.end() && *live == t)
+    {
+        live = liveentities.erase(live);
+    }
+    for (; live != liveentities.end(); ++live)
+    {
+        --*live;
+    }
+
+    if (!last)
+    {
+        /* Ascending order is already a valid min-heap */
+        freeentities.clear();
+        for (size_t i = 0; i < entities.size(); ++i)
+        {
+            if (isdisabled(entities[i]))
+            {
+                freeentities.push_back(i);
+            }
+        }
+    }
+}
+
+void entityclass::removeallentities(void)
+{
+    entities.clear();
+    liveentities.clear();
+    freeentities.clear();
+}
+
+int entityclass::nextliveentity(const int t)
+{
+    std::vector<int>::const_iterator it = std::upper_bound(
+        liveentities.begin(),
+        liveentities.end(),
+        t
+    );
+
+    return it != liveentities.end() ? *it : -1;
+}
+
+int entityclass::prevliveentity(const int t)
+{
+    std::vector<int>::const_iterator it = std::lower_bound(
+        liveentities.begin(),
+        liveentities.end(),
+        t
+    );
+
+    return it != liveentities.begin() ? *(it - 1) : -1;
+}
+
 void entityclass::removeallblocks(void)
 {
     blocks.clear();
@@ -1234,13 +1331,14 @@ void entityclass::createentity(int xp, int yp, int t, int meta1, int meta2, int
 
     /* Can we reuse the slot of a disabled entity? */
     bool reuse = false;
-    for (size_t i = 0; i < entities.size(); ++i)
+    while (!freeentities.empty())
     {
-        if (entities[i].invis
-        && entities[i].size == -1
-        && entities[i].type == -1
-        && entities[i].rule == -1
-        && !entities[i].isplatform)
+        const int i = freeentities.front();
+        std::pop_heap(freeentities.begin(), freeentities.end(), std::greater<int>());
+        freeentities.pop_back();
+
+        /* Slots can go stale if they got reused or removed since */
+        if (INBOUNDS_VEC(i, entities) && isdisabled(entities[i]))
         {
             reuse = true;
             entptr = &entities[i];
@@ -2125,9 +2223,20 @@ void entityclass::createentity(int xp, int yp, int t, int meta1, int meta2, int
     entity.lerpoldyp = entity.yp;
     entity.drawframe = entity.tile;
 
-    if (!reuse)
+    size_t indice;
+    if (reuse)
+    {
+        indice = entptr - entities.data();
+        liveentities.insert(
+            std::lower_bound(liveentities.begin(), liveentities.end(), (int) indice),
+            indice
+        );
+    }
+    else
     {
         entities.push_back(entity);
+        indice = entities.size() - 1;
+        liveentities.push_back(indice);
     }
 
     /* Fix crewmate facing directions
@@ -2136,15 +2245,6 @@ void entityclass::createentity(int xp, int yp, int t, int meta1, int meta2, int
      */
     if (entity.type == 12)
     {
-        size_t indice;
-        if (reuse)
-        {
-            indice = entptr - entities.data();
-        }
-        else
-        {
-            indice = entities.size() - 1;
-        }
         updateentities(indice);
     }
 }
@@ -4672,7 +4772,7 @@ void entityclass::customwarplinecheck(int i) {
 
 void entityclass::entitycollisioncheck(void)
 {
-    for (size_t i = 0; i < entities.size(); i++)
+    for (int i = nextliveentity(-1); i >= 0; i = nextliveentity(i))
     {
         bool player = entities[i].rule == 0;
         bool scm = game.supercrewmate && entities[i].type == 14;
@@ -4682,7 +4782,9 @@ void entityclass::entitycollisioncheck(void)
         }
 
         //We test entity to entity
-        for (size_t j = 0; j < entities.size(); j++)
+        //(Disabled entities have no rule, so skipping them changes nothing.
+        //Collecting something disables it, so step rather than index.)
+        for (int j = nextliveentity(-1); j >= 0; j = nextliveentity(j))
         {
             if (i == j)
             {
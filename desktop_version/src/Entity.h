@@ -7,6 +7,7 @@
 
 #include "Maths.h"
 #include "Ent.h"
+#include "EngineLocal.h"
 #include "BlockV.h"
 #include "Game.h"
 
@@ -68,6 +69,17 @@ public:
 
     bool disableentity(int t);
 
+    void removeentity(int t);
+
+    void removeallentities(void);
+
+    /* The live entity after or before t, or -1 if there isn't one. Sweeps
+     * that can create or disable entities as they go step with these
+     * instead of indexing liveentities, which those change under them. */
+    int nextliveentity(int t);
+
+    int prevliveentity(int t);
+
     void removeallblocks(void);
 
     void disableblock(int t);
@@ -175,6 +187,13 @@ public:
 
     std::vector<entclass> entities;
 
+    /* Indices of entities that aren't disabled, in ascending order */
+    std::vector<int> liveentities;
+
+    /* Disabled slots for createentity() to reuse, as a min-heap so the lowest
+     * one gets reused first. May have stale indices, they're checked on use. */
+    std::vector<int> freeentities;
+
     int k;
 
 
@@ -210,7 +229,7 @@ public:
 };
 
 #ifndef OBJ_DEFINITION
-extern entityclass obj;
+extern ENGINE_LOCAL entityclass& obj;
 #endif
 
 #endif /* ENTITY_H */
@@ -1,13 +1,16 @@
+#include <map>
 #include <physfs.h>
 #include <SDL.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string>
 #include <tinyxml2.h>
 
 #include "BinaryBlob.h"
 #include "Exit.h"
 #include "Graphics.h"
 #include "Maths.h"
+#include "Music.h"
 #include "Screen.h"
 #include "Unused.h"
 #include "UtilityClass.h"
@@ -29,9 +32,13 @@ static int mkdir(char* path, int mode)
 #include <emscripten.h>
 #define MAX_PATH PATH_MAX
 #elif defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__HAIKU__) || defined(__DragonFly__) || defined(__unix__)
+#include <fcntl.h>
 #include <limits.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #define MAX_PATH PATH_MAX
+#define HAVE_MMAP
 #endif
 
 static const char* pathSep = NULL;
@@ -42,6 +49,19 @@ static char levelDir[MAX_PATH] = {'\0'};
 static char assetDir[MAX_PATH] = {'\0'};
 static char virtualMountPath[MAX_PATH] = {'\0'};
 
+/* Enough to tell whether anything in an asset directory or zip has changed
+ * since it was loaded, without reading any of it */
+struct AssetStamp
+{
+    PHYSFS_sint64 newest;
+    PHYSFS_uint64 files;
+    PHYSFS_uint64 bytes;
+};
+
+/* What assetDir was mounted from, relative to the search path */
+static char assetName[MAX_PATH] = {'\0'};
+static struct AssetStamp assetStamp;
+
 static int PLATFORM_getOSDirectory(char* output, const size_t output_size);
 
 static void* bridged_malloc(PHYSFS_uint64 size)
@@ -310,10 +330,64 @@ static int setLevelDirError(const char* text, ...)
     return retval;
 }
 
+static void addToAssetStamp(struct AssetStamp* stamp, const char* fname);
+
+static PHYSFS_EnumerateCallbackResult assetStampCallback(
+    void* data,
+    const char* origdir,
+    const char* filename
+) {
+    char path[MAX_PATH];
+
+    SDL_snprintf(path, sizeof(path), "%s/%s", origdir, filename);
+    addToAssetStamp((struct AssetStamp*) data, path);
+
+    return PHYSFS_ENUM_OK;
+}
+
+static void addToAssetStamp(struct AssetStamp* stamp, const char* fname)
+{
+    PHYSFS_Stat stat;
+
+    if (!PHYSFS_stat(fname, &stat))
+    {
+        return;
+    }
+
+    /* Editing a file in a directory doesn't touch the directory, so look
+     * inside. A zip gets written over as a whole, so it's enough on its own. */
+    stamp->newest = SDL_max(stamp->newest, stat.modtime);
+    stamp->files++;
+    if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+    {
+        PHYSFS_enumerate(fname, assetStampCallback, (void*) stamp);
+    }
+    else
+    {
+        stamp->bytes += stat.filesize;
+    }
+}
+
+static void getAssetStamp(struct AssetStamp* stamp, const char* fname)
+{
+    SDL_zerop(stamp);
+    addToAssetStamp(stamp, fname);
+}
+
+static bool sameAssetStamp(const struct AssetStamp* a, const struct AssetStamp* b)
+{
+    return a->newest == b->newest
+    && a->files == b->files
+    && a->bytes == b->bytes;
+}
+
+static void unmountAssetDir(void);
+
 static bool FILESYSTEM_mountAssetsFrom(const char *fname)
 {
     const char* real_dir = PHYSFS_getRealDir(fname);
     char path[MAX_PATH];
+    struct AssetStamp stamp;
 
     if (real_dir == NULL)
     {
@@ -326,6 +400,31 @@ static bool FILESYSTEM_mountAssetsFrom(const char *fname)
 
     SDL_snprintf(path, sizeof(path), "%s/%s", real_dir, fname);
 
+    /* Taken before anything's read, so changes made while loading get
+     * picked up next time */
+    getAssetStamp(&stamp, fname);
+
+    if (SDL_strcmp(path, assetDir) == 0)
+    {
+        if (sameAssetStamp(&stamp, &assetStamp))
+        {
+            /* Another level with the same assets, e.g. the next playtest of
+             * the same level. Everything's already loaded, unless it was
+             * another libvvvvvv instance that mounted it. */
+            vlog_debug("Keeping %s mounted", assetDir);
+            if (graphics.assets_loaded != assetDir)
+            {
+                return graphics.reloadresources();
+            }
+            return true;
+        }
+        vlog_info("%s has changed since it was loaded", assetDir);
+    }
+
+    /* No need to load the default assets in between */
+    const bool was_mounted = assetDir[0] != '\0';
+    unmountAssetDir();
+
     generateVirtualMountPath(virtualMountPath, sizeof(virtualMountPath));
 
     if (!PHYSFS_mount(path, virtualMountPath, 0))
@@ -335,11 +434,18 @@ static bool FILESYSTEM_mountAssetsFrom(const char *fname)
             fname,
             PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
         );
+        if (was_mounted)
+        {
+            graphics.reloadresources();
+        }
         return false;
     }
 
     SDL_strlcpy(assetDir, path, sizeof(assetDir));
-    return true;
+    SDL_strlcpy(assetName, fname, sizeof(assetName));
+    assetStamp = stamp;
+
+    return graphics.reloadresources();
 }
 
 struct ArchiveState
@@ -378,6 +484,16 @@ static PHYSFS_EnumerateCallbackResult zipCheckCallback(
     return PHYSFS_ENUM_OK;
 }
 
+enum ZipStructure
+{
+    ZIP_UNCHECKED,
+    ZIP_OK,
+    ZIP_UNREADABLE,
+    ZIP_NO_LEVEL_FILES,
+    ZIP_MISSING_LEVEL_FILE,
+    ZIP_OTHER_LEVEL_FILES
+};
+
 /* For technical reasons, the level file inside a zip named LEVELNAME.zip must
  * be named LEVELNAME.vvvvvv, else its custom assets won't work;
  * if there are .vvvvvv files other than LEVELNAME.vvvvvv, they would be loaded
@@ -386,9 +502,17 @@ static PHYSFS_EnumerateCallbackResult zipCheckCallback(
  * For user-friendliness, we check this upfront and reject all zips that don't
  * conform to this (regardless of them containing assets or not) - otherwise a
  * level zip with assets can be played but its assets mysteriously won't work
+ *
+ * If the zip is fine and there's a callback, it's given the level file while
+ * the zip is still mounted for checking, so it can read it without mounting
+ * the zip again
  */
-static bool checkZipStructure(const char* filename)
-{
+static enum ZipStructure checkZipStructure(
+    const char* filename,
+    const char* level_filename,
+    const PHYSFS_sint64 mtime,
+    void (*callback)(const char* filename, const char* path, int64_t mtime)
+) {
     const char* real_dir = PHYSFS_getRealDir(filename);
     char base_name[MAX_PATH];
     char base_name_suffixed[MAX_PATH];
@@ -396,7 +520,7 @@ static bool checkZipStructure(const char* filename)
     char mount_path[MAX_PATH];
     char check_path[MAX_PATH];
     char random_str[6 + 1];
-    bool success;
+    enum ZipStructure structure;
     bool file_exists;
     struct ArchiveState zip_state;
 
@@ -406,7 +530,7 @@ static bool checkZipStructure(const char* filename)
             "Could not check %s: real directory doesn't exist",
             filename
         );
-        return false;
+        return ZIP_UNREADABLE;
     }
 
     SDL_snprintf(real_path, sizeof(real_path), "%s/%s", real_dir, filename);
@@ -421,7 +545,7 @@ static bool checkZipStructure(const char* filename)
             filename,
             PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
         );
-        return false;
+        return ZIP_UNREADABLE;
     }
 
     VVV_between(filename, "levels/", base_name, ".zip");
@@ -442,64 +566,336 @@ static bool checkZipStructure(const char* filename)
     );
 
     file_exists = PHYSFS_exists(check_path);
-    success = file_exists;
 
     SDL_zero(zip_state);
     zip_state.filename = base_name_suffixed;
 
     PHYSFS_enumerate(mount_path, zipCheckCallback, (void*) &zip_state);
 
-    /* If no .vvvvvv files in zip, don't print warning. */
-    if (!success && zip_state.has_extension)
+    if (!file_exists)
     {
-        setLevelDirError(
-            "%s.zip is not structured correctly! It is missing %s.vvvvvv.",
-            base_name,
-            base_name
+        structure = zip_state.has_extension ?
+            ZIP_MISSING_LEVEL_FILE : ZIP_NO_LEVEL_FILES;
+    }
+    else if (zip_state.other_level_files)
+    {
+        structure = ZIP_OTHER_LEVEL_FILES;
+    }
+    else
+    {
+        structure = ZIP_OK;
+        if (callback != NULL)
+        {
+            callback(level_filename, check_path, mtime);
+        }
+    }
+
+    if (!PHYSFS_unmount(real_path))
+    {
+        vlog_error(
+            "Could not unmount %s: %s",
+            mount_path,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
         );
     }
 
-    success &= !zip_state.other_level_files;
+    return structure;
+}
 
-    /* ...But if other .vvvvvv file(s), do print warning. */
-    /* This message is redundant if the correct file already DOESN'T exist. */
-    if (file_exists && zip_state.other_level_files)
+static void reportZipStructure(
+    const char* filename,
+    const enum ZipStructure structure
+) {
+    char base_name[MAX_PATH];
+
+    VVV_between(filename, "levels/", base_name, ".zip");
+
+    switch (structure)
     {
+    case ZIP_MISSING_LEVEL_FILE:
+        setLevelDirError(
+            "%s.zip is not structured correctly! It is missing %s.vvvvvv.",
+            base_name,
+            base_name
+        );
+        break;
+    case ZIP_OTHER_LEVEL_FILES:
         setLevelDirError(
             "%s.zip is not structured correctly! It has .vvvvvv file(s) other than %s.vvvvvv.",
             base_name,
             base_name
         );
+        break;
+    default:
+        /* If no .vvvvvv files in zip, don't print warning. */
+        break;
     }
+}
 
-    if (!PHYSFS_unmount(real_path))
+/* Every zip in the levels directory we know about, keyed by the level file it
+ * should contain (levels/LEVELNAME.vvvvvv). Zips are only checked when they're
+ * new or their modification time changed, and only mounted when a level
+ * inside is actually read - and then only one at a time, so having thousands
+ * of them doesn't cost thousands of PhysFS handles. */
+struct LevelZip
+{
+    std::string filename;
+    PHYSFS_sint64 mtime;
+    enum ZipStructure structure;
+    bool mounted;
+    bool seen;
+    /* Set when checking the zip already gave its level file to the callback */
+    bool read;
+};
+
+typedef std::map<std::string, struct LevelZip> LevelZipMap;
+static LevelZipMap levelZips;
+
+static PHYSFS_sint64 getModTime(const char* filename)
+{
+    PHYSFS_Stat stat;
+
+    if (!PHYSFS_stat(filename, &stat))
+    {
+        return -1;
+    }
+
+    return stat.modtime;
+}
+
+static void unmountLevelZip(struct LevelZip* zip)
+{
+    if (!zip->mounted)
+    {
+        return;
+    }
+
+    if (!PHYSFS_unmount(zip->filename.c_str()))
     {
         vlog_error(
             "Could not unmount %s: %s",
-            mount_path,
+            zip->filename.c_str(),
             PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
         );
+        return;
+    }
+
+    zip->mounted = false;
+}
+
+static void invalidateLevelZip(struct LevelZip* zip, const PHYSFS_sint64 mtime)
+{
+    unmountLevelZip(zip);
+    zip->mtime = mtime;
+    zip->structure = ZIP_UNCHECKED;
+}
+
+/* The callback is only called if the zip gets checked now */
+static enum ZipStructure getZipStructure(
+    const char* level_filename,
+    struct LevelZip* zip,
+    void (*callback)(const char* filename, const char* path, int64_t mtime)
+) {
+    if (zip->structure == ZIP_UNCHECKED)
+    {
+        zip->structure = checkZipStructure(
+            zip->filename.c_str(),
+            level_filename,
+            zip->mtime,
+            callback
+        );
+        zip->read = callback != NULL;
     }
 
-    return success;
+    return zip->structure;
 }
 
-void FILESYSTEM_loadZip(const char* filename)
+void FILESYSTEM_enumerateLevelDirFileNames(
+    void (*callback)(const char* filename)
+);
+
+static void levelZipCallback(const char* filename)
 {
-    PHYSFS_File* zip = PHYSFS_openRead(filename);
+    char base_name[MAX_PATH];
+    char level_filename[MAX_PATH];
+    PHYSFS_sint64 mtime;
+    LevelZipMap::iterator it;
 
-    if (!checkZipStructure(filename))
+    if (!endsWith(filename, ".zip") || !FILESYSTEM_isFile(filename))
     {
         return;
     }
 
-    if (!PHYSFS_mountHandle(zip, filename, "levels", 1))
+    VVV_between(filename, "levels/", base_name, ".zip");
+    SDL_snprintf(
+        level_filename,
+        sizeof(level_filename),
+        "levels/%s.vvvvvv",
+        base_name
+    );
+
+    mtime = getModTime(filename);
+
+    it = levelZips.find(level_filename);
+    if (it == levelZips.end())
+    {
+        struct LevelZip zip;
+        zip.filename = filename;
+        zip.mtime = mtime;
+        zip.structure = ZIP_UNCHECKED;
+        zip.mounted = false;
+        zip.seen = true;
+        zip.read = false;
+        levelZips[level_filename] = zip;
+        return;
+    }
+
+    if (it->second.mtime != mtime)
+    {
+        invalidateLevelZip(&it->second, mtime);
+    }
+    it->second.seen = true;
+}
+
+void FILESYSTEM_scanLevelZips(void)
+{
+    LevelZipMap::iterator it;
+
+    for (it = levelZips.begin(); it != levelZips.end(); ++it)
+    {
+        it->second.seen = false;
+    }
+
+    FILESYSTEM_enumerateLevelDirFileNames(levelZipCallback);
+
+    it = levelZips.begin();
+    while (it != levelZips.end())
+    {
+        if (!it->second.seen)
+        {
+            unmountLevelZip(&it->second);
+            levelZips.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void FILESYSTEM_enumerateLevelZips(
+    void (*callback)(const char* filename, const char* path, int64_t mtime)
+) {
+    LevelZipMap::iterator it;
+
+    for (it = levelZips.begin(); it != levelZips.end(); ++it)
+    {
+        enum ZipStructure structure;
+
+        it->second.read = false;
+        structure = getZipStructure(it->first.c_str(), &it->second, callback);
+
+        if (structure != ZIP_OK)
+        {
+            reportZipStructure(it->second.filename.c_str(), structure);
+            continue;
+        }
+
+        if (!it->second.read)
+        {
+            callback(it->first.c_str(), NULL, it->second.mtime);
+        }
+    }
+}
+
+void FILESYSTEM_setLevelZipChecked(const char* filename, const int64_t mtime)
+{
+    LevelZipMap::iterator it = levelZips.find(filename);
+
+    if (it != levelZips.end()
+    && it->second.mtime == mtime
+    && it->second.structure == ZIP_UNCHECKED)
+    {
+        it->second.structure = ZIP_OK;
+    }
+}
+
+bool FILESYSTEM_isLevelZipped(const char* filename)
+{
+    LevelZipMap::iterator it = levelZips.find(filename);
+
+    return it != levelZips.end()
+    && getZipStructure(it->first.c_str(), &it->second, NULL) == ZIP_OK;
+}
+
+bool FILESYSTEM_mountLevelZip(const char* filename)
+{
+    LevelZipMap::iterator it = levelZips.find(filename);
+    LevelZipMap::iterator other;
+    struct LevelZip* zip;
+    PHYSFS_sint64 mtime;
+    PHYSFS_File* handle;
+
+    if (it == levelZips.end())
+    {
+        return false;
+    }
+    zip = &it->second;
+
+    mtime = getModTime(zip->filename.c_str());
+    if (mtime != zip->mtime)
+    {
+        invalidateLevelZip(zip, mtime);
+    }
+
+    if (getZipStructure(it->first.c_str(), zip, NULL) != ZIP_OK)
+    {
+        return false;
+    }
+
+    if (zip->mounted)
+    {
+        return true;
+    }
+
+    for (other = levelZips.begin(); other != levelZips.end(); ++other)
+    {
+        unmountLevelZip(&other->second);
+    }
+
+    handle = PHYSFS_openRead(zip->filename.c_str());
+    if (handle == NULL)
+    {
+        vlog_error(
+            "Could not open %s: %s",
+            zip->filename.c_str(),
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
+        );
+        return false;
+    }
+
+    if (!PHYSFS_mountHandle(handle, zip->filename.c_str(), "levels", 1))
     {
         vlog_error(
             "Could not mount %s: %s",
-            filename,
+            zip->filename.c_str(),
             PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
         );
+        PHYSFS_close(handle);
+        return false;
+    }
+
+    zip->mounted = true;
+    return true;
+}
+
+void FILESYSTEM_unmountLevelZips(void)
+{
+    LevelZipMap::iterator it;
+
+    for (it = levelZips.begin(); it != levelZips.end(); ++it)
+    {
+        unmountLevelZip(&it->second);
     }
 }
 
@@ -507,6 +903,7 @@ void FILESYSTEM_unmountAssets(void);
 
 bool FILESYSTEM_mountAssets(const char* path)
 {
+    const EngineProcessLock lock;
     char filename[MAX_PATH];
     char virtual_path[MAX_PATH];
 
@@ -525,10 +922,8 @@ bool FILESYSTEM_mountAssets(const char* path)
 
         if (!FILESYSTEM_mountAssetsFrom(virtual_path))
         {
-            return false;
+            goto fail;
         }
-
-        MAYBE_FAIL(graphics.reloadresources());
     }
     else
     {
@@ -545,10 +940,8 @@ bool FILESYSTEM_mountAssets(const char* path)
 
             if (!FILESYSTEM_mountAssetsFrom(virtual_path))
             {
-                return false;
+                goto fail;
             }
-
-            MAYBE_FAIL(graphics.reloadresources());
         }
         else
         {
@@ -565,15 +958,14 @@ bool FILESYSTEM_mountAssets(const char* path)
 
                 if (!FILESYSTEM_mountAssetsFrom(virtual_path))
                 {
-                    return false;
+                    goto fail;
                 }
-
-                MAYBE_FAIL(graphics.reloadresources());
             }
             else
             {
                 /* Wasn't a level zip, base zip, or folder! */
                 vlog_debug("Asset directory does not exist");
+                FILESYSTEM_unmountAssets();
             }
         }
     }
@@ -585,13 +977,27 @@ fail:
     return false;
 }
 
-void FILESYSTEM_unmountAssets(void)
+static void unmountAssetDir(void)
 {
     if (assetDir[0] != '\0')
     {
         vlog_info("Unmounting %s", assetDir);
+        /* Music may be streaming from the archive, and PhysFS refuses to
+         * unmount archives with open files */
+        music.destroy();
         PHYSFS_unmount(assetDir);
         assetDir[0] = '\0';
+        assetName[0] = '\0';
+    }
+}
+
+void FILESYSTEM_unmountAssets(void)
+{
+    const EngineProcessLock lock;
+
+    if (assetDir[0] != '\0')
+    {
+        unmountAssetDir();
         graphics.reloadresources();
     }
     else
@@ -600,6 +1006,48 @@ void FILESYSTEM_unmountAssets(void)
     }
 }
 
+bool FILESYSTEM_reloadAssets(void)
+{
+    const EngineProcessLock lock;
+    char path[MAX_PATH];
+    char name[MAX_PATH];
+    struct AssetStamp stamp;
+
+    if (assetDir[0] == '\0')
+    {
+        return true;
+    }
+
+    /* PhysFS reads a zip's directory once, when it's mounted, so it has to
+     * be mounted again to see what changed in it */
+    SDL_strlcpy(path, assetDir, sizeof(path));
+    SDL_strlcpy(name, assetName, sizeof(name));
+    getAssetStamp(&stamp, name);
+    unmountAssetDir();
+
+    if (!PHYSFS_mount(path, virtualMountPath, 0))
+    {
+        vlog_error(
+            "Error mounting %s: %s",
+            path,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
+        );
+        graphics.reloadresources();
+        return false;
+    }
+
+    SDL_strlcpy(assetDir, path, sizeof(assetDir));
+    SDL_strlcpy(assetName, name, sizeof(assetName));
+    assetStamp = stamp;
+
+    return graphics.reloadresources();
+}
+
+const char* FILESYSTEM_getAssetPath(void)
+{
+    return assetDir;
+}
+
 static void getMountedPath(
     char* buffer,
     const size_t buffer_size,
@@ -660,9 +1108,9 @@ void FILESYSTEM_freeMemory(unsigned char **mem);
 static void load_stdin(void)
 {
     size_t pos = 0;
-    /* A .vvvvvv file with nothing is at least 140K...
-     * initial size of 1K shouldn't hurt. */
-#define INITIAL_SIZE 1024
+    /* A .vvvvvv file with nothing is at least 140K, so read it in big
+     * chunks instead of a byte at a time */
+#define INITIAL_SIZE (256 * 1024)
     size_t alloc_size = INITIAL_SIZE;
     stdin_buffer = (unsigned char*) SDL_malloc(INITIAL_SIZE);
 #undef INITIAL_SIZE
@@ -674,16 +1122,8 @@ static void load_stdin(void)
 
     while (true)
     {
-        int ch = fgetc(stdin);
-        bool end = ch == EOF;
-        if (end)
-        {
-            /* Add null terminator. There's no observable change in
-             * behavior if addnull is always true, but not vice versa. */
-            ch = '\0';
-        }
-
-        if (pos == alloc_size)
+        /* Always keep room for the null terminator */
+        if (alloc_size - pos < 2)
         {
             unsigned char *tmp;
             alloc_size *= 2;
@@ -695,16 +1135,24 @@ static void load_stdin(void)
             stdin_buffer = tmp;
         }
 
-        stdin_buffer[pos] = ch;
-        ++pos;
+        const size_t got = fread(
+            &stdin_buffer[pos],
+            1,
+            alloc_size - pos - 1,
+            stdin
+        );
+        pos += got;
 
-        if (end)
+        if (got == 0 && (feof(stdin) || ferror(stdin)))
         {
             break;
         }
     }
 
-    stdin_length = pos - 1;
+    /* Add null terminator. There's no observable change in
+     * behavior if addnull is always true, but not vice versa. */
+    stdin_buffer[pos] = '\0';
+    stdin_length = pos;
 }
 
 void FILESYSTEM_loadFileToMemory(
@@ -814,6 +1262,128 @@ void FILESYSTEM_freeMemory(unsigned char **mem)
     *mem = NULL;
 }
 
+/* Turn a PhysFS path into the path of the file on disk, assuming the
+ * directory it was found in is a real directory and not an archive. */
+static bool getRealPath(
+    char* buffer,
+    const size_t buffer_size,
+    const char* filename
+) {
+    const char* real_dir = PHYSFS_getRealDir(filename);
+    const char* mount_point;
+    const char* relative_path = filename;
+    size_t mount_point_len;
+
+    if (real_dir == NULL)
+    {
+        return false;
+    }
+
+    mount_point = PHYSFS_getMountPoint(real_dir);
+    if (mount_point != NULL)
+    {
+        mount_point_len = SDL_strlen(mount_point);
+        if (SDL_strncmp(filename, mount_point, mount_point_len) == 0)
+        {
+            relative_path = &filename[mount_point_len];
+        }
+    }
+
+    SDL_snprintf(buffer, buffer_size, "%s/%s", real_dir, relative_path);
+    return true;
+}
+
+static const char* mapRealFile(const char* real_path, size_t* length)
+{
+#if defined(_WIN32)
+    WCHAR utf16_path[MAX_PATH];
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER size;
+    const char* view;
+
+    MultiByteToWideChar(CP_UTF8, 0, real_path, -1, utf16_path, MAX_PATH);
+
+    file = CreateFileW(
+        utf16_path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+    {
+        return NULL;
+    }
+
+    /* The view keeps the mapping alive */
+    view = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL)
+    {
+        return NULL;
+    }
+
+    *length = size.QuadPart;
+    return view;
+#elif defined(HAVE_MMAP)
+    struct stat info;
+    void* mapping;
+    int fd = open(real_path, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    *length = info.st_size;
+    return (const char*) mapping;
+#else
+    UNUSED(real_path);
+    UNUSED(length);
+    return NULL;
+#endif
+}
+
+void FILESYSTEM_unmapFile(const char* mapping, const size_t length)
+{
+#if defined(_WIN32)
+    UNUSED(length);
+    UnmapViewOfFile(mapping);
+#elif defined(HAVE_MMAP)
+    munmap((void*) mapping, length);
+#else
+    UNUSED(mapping);
+    UNUSED(length);
+#endif
+}
+
 bool FILESYSTEM_loadBinaryBlob(binaryBlob* blob, const char* filename)
 {
     PHYSFS_sint64 size;
@@ -821,6 +1391,7 @@ bool FILESYSTEM_loadBinaryBlob(binaryBlob* blob, const char* filename)
     int valid, offset;
     size_t i;
     char path[MAX_PATH];
+    char real_path[MAX_PATH];
 
     if (blob == NULL || filename == NULL)
     {
@@ -844,13 +1415,14 @@ bool FILESYSTEM_loadBinaryBlob(binaryBlob* blob, const char* filename)
         sizeof(blob->m_headers)
     );
 
+    PHYSFS_close(handle);
+
     valid = 0;
     offset = sizeof(blob->m_headers);
 
     for (i = 0; i < SDL_arraysize(blob->m_headers); ++i)
     {
         resourceheader* header = &blob->m_headers[i];
-        char** memblock = &blob->m_memblocks[i];
 
         /* Name can be stupid, just needs to be terminated */
         static const size_t last_char = sizeof(header->name) - 1;
@@ -869,13 +1441,8 @@ bool FILESYSTEM_loadBinaryBlob(binaryBlob* blob, const char* filename)
             goto fail; /* Bogus size value */
         }
 
-        PHYSFS_seek(handle, offset);
-        *memblock = (char*) SDL_malloc(header->size);
-        if (*memblock == NULL)
-        {
-            VVV_exit(1); /* Oh god we're out of memory, just bail */
-        }
-        PHYSFS_readBytes(handle, *memblock, header->size);
+        /* Don't read the track yet, just remember where it is */
+        blob->m_offsets[i] = offset;
         offset += header->size;
         valid += 1;
 
@@ -884,14 +1451,36 @@ fail:
         header->valid = false;
     }
 
-    PHYSFS_close(handle);
-
     if (valid == 0)
     {
         return false;
     }
 
-    vlog_debug("The complete reloaded file size: %lli", size);
+    /* Map the whole file if it's on disk, so tracks only get paged in
+     * while they're being played. Otherwise stream them through PhysFS. */
+    if (getRealPath(real_path, sizeof(real_path), path))
+    {
+        size_t mapping_size = 0;
+        const char* mapping = mapRealFile(real_path, &mapping_size);
+
+        if (mapping != NULL && mapping_size != (size_t) size)
+        {
+            /* Not the file PhysFS found, somehow */
+            FILESYSTEM_unmapFile(mapping, mapping_size);
+            mapping = NULL;
+        }
+
+        blob->m_mapping = mapping;
+        blob->m_mapping_size = mapping != NULL ? mapping_size : 0;
+    }
+
+    SDL_strlcpy(blob->m_path, path, sizeof(blob->m_path));
+
+    vlog_debug(
+        "The complete reloaded file size: %lli (%s)",
+        size,
+        blob->m_mapping != NULL ? "mapped" : "streamed"
+    );
 
     for (i = 0; i < SDL_arraysize(blob->m_headers); ++i)
     {
@@ -908,6 +1497,168 @@ fail:
     return true;
 }
 
+/* A read-only SDL_RWops over a byte range of a PhysFS file, so each track of
+ * a blob that isn't on disk can be streamed without reading the others. */
+struct SliceRW
+{
+    PHYSFS_File* handle;
+    Sint64 start;
+    Sint64 size;
+    Sint64 position;
+};
+
+static Sint64 SliceRW_size(SDL_RWops* rw)
+{
+    const struct SliceRW* slice = (const struct SliceRW*) rw->hidden.unknown.data1;
+    return slice->size;
+}
+
+static Sint64 SliceRW_seek(SDL_RWops* rw, const Sint64 offset, const int whence)
+{
+    struct SliceRW* slice = (struct SliceRW*) rw->hidden.unknown.data1;
+    Sint64 position;
+
+    switch (whence)
+    {
+    case RW_SEEK_SET:
+        position = offset;
+        break;
+    case RW_SEEK_CUR:
+        position = slice->position + offset;
+        break;
+    case RW_SEEK_END:
+        position = slice->size + offset;
+        break;
+    default:
+        return SDL_SetError("Unknown value for 'whence'");
+    }
+
+    if (position < 0 || position > slice->size)
+    {
+        return SDL_SetError("Seek outside of track");
+    }
+
+    slice->position = position;
+    return position;
+}
+
+static size_t SliceRW_read(
+    SDL_RWops* rw,
+    void* ptr,
+    const size_t size,
+    const size_t maxnum
+) {
+    struct SliceRW* slice = (struct SliceRW*) rw->hidden.unknown.data1;
+    const Sint64 wanted = size * maxnum;
+    Sint64 available = slice->size - slice->position;
+    PHYSFS_sint64 bytes_read;
+
+    if (size == 0 || available <= 0)
+    {
+        return 0;
+    }
+    if (available > wanted)
+    {
+        available = wanted;
+    }
+
+    if (PHYSFS_tell(slice->handle) != slice->start + slice->position
+    && !PHYSFS_seek(slice->handle, slice->start + slice->position))
+    {
+        SDL_SetError("%s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        return 0;
+    }
+
+    bytes_read = PHYSFS_readBytes(slice->handle, ptr, available);
+    if (bytes_read <= 0)
+    {
+        return 0;
+    }
+
+    slice->position += bytes_read;
+    return bytes_read / size;
+}
+
+static size_t SliceRW_write(
+    SDL_RWops* rw,
+    const void* ptr,
+    const size_t size,
+    const size_t num
+) {
+    UNUSED(rw);
+    UNUSED(ptr);
+    UNUSED(size);
+    UNUSED(num);
+    SDL_SetError("Tracks are read-only");
+    return 0;
+}
+
+static int SliceRW_close(SDL_RWops* rw)
+{
+    struct SliceRW* slice = (struct SliceRW*) rw->hidden.unknown.data1;
+
+    PHYSFS_close(slice->handle);
+    SDL_free(slice);
+    SDL_FreeRW(rw);
+    return 0;
+}
+
+SDL_RWops* FILESYSTEM_openSliceRW(
+    const char* path,
+    const int start,
+    const int size
+) {
+    struct SliceRW* slice;
+    SDL_RWops* rw;
+    PHYSFS_File* handle = PHYSFS_openRead(path);
+
+    if (handle == NULL)
+    {
+        vlog_error(
+            "Unable to open %s: %s",
+            path,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
+        );
+        return NULL;
+    }
+
+    slice = (struct SliceRW*) SDL_malloc(sizeof(*slice));
+    rw = SDL_AllocRW();
+    if (slice == NULL || rw == NULL)
+    {
+        VVV_exit(1);
+    }
+
+    slice->handle = handle;
+    slice->start = start;
+    slice->size = size;
+    slice->position = 0;
+
+    rw->size = SliceRW_size;
+    rw->seek = SliceRW_seek;
+    rw->read = SliceRW_read;
+    rw->write = SliceRW_write;
+    rw->close = SliceRW_close;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = slice;
+
+    return rw;
+}
+
+bool FILESYSTEM_saveFile(const char* name, const void* data, const size_t length)
+{
+    PHYSFS_File* handle = PHYSFS_openWrite(name);
+    PHYSFS_sint64 written;
+    if (handle == NULL)
+    {
+        return false;
+    }
+    written = PHYSFS_writeBytes(handle, data, length);
+    PHYSFS_close(handle);
+
+    return written == (PHYSFS_sint64) length;
+}
+
 bool FILESYSTEM_saveTiXml2Document(const char *name, tinyxml2::XMLDocument& doc, bool sync /*= true*/)
 {
     /* XMLDocument.SaveFile doesn't account for Unicode paths, PHYSFS does */
@@ -1087,6 +1838,27 @@ bool FILESYSTEM_delete(const char *name)
     return PHYSFS_delete(name) != 0;
 }
 
+bool FILESYSTEM_createDirectory(const char *name)
+{
+    return PHYSFS_mkdir(name) != 0;
+}
+
+bool FILESYSTEM_redirectWrites(const char* realDir)
+{
+    /* In front of the user directory, so the game reads back what it wrote */
+    if (!PHYSFS_mount(realDir, NULL, 0) || !PHYSFS_setWriteDir(realDir))
+    {
+        vlog_error(
+            "Could not redirect writes to %s: %s",
+            realDir,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())
+        );
+        return false;
+    }
+    /* Saves go in here, and PhysFS won't make it on the way */
+    return FILESYSTEM_createDirectory("saves");
+}
+
 static void levelSaveCallback(const char* filename)
 {
     if (endsWith(filename, ".vvvvvv.vvv"))
@@ -1,10 +1,12 @@
 #ifndef FILESYSTEMUTILS_H
 #define FILESYSTEMUTILS_H
 
-/* Forward declaration */
+/* Forward declarations */
 class binaryBlob;
+struct SDL_RWops;
 
 #include <stddef.h>
+#include <stdint.h>
 
 // Forward declaration, including the entirety of tinyxml2.h across all files this file is included in is unnecessary
 namespace tinyxml2 { class XMLDocument; }
@@ -18,9 +20,24 @@ char *FILESYSTEM_getUserLevelDirectory(void);
 bool FILESYSTEM_isFile(const char* filename);
 bool FILESYSTEM_isMounted(const char* filename);
 
-void FILESYSTEM_loadZip(const char* filename);
+void FILESYSTEM_scanLevelZips(void);
+/* path is where the level file can be read right now without mounting its
+ * zip, or NULL if FILESYSTEM_mountLevelZip() is needed to read it */
+void FILESYSTEM_enumerateLevelZips(
+    void (*callback)(const char* filename, const char* path, int64_t mtime)
+);
+/* For a zip known to be fine from an earlier run, so it isn't checked again
+ * unless it's changed since */
+void FILESYSTEM_setLevelZipChecked(const char* filename, int64_t mtime);
+bool FILESYSTEM_isLevelZipped(const char* filename);
+bool FILESYSTEM_mountLevelZip(const char* filename);
+void FILESYSTEM_unmountLevelZips(void);
 bool FILESYSTEM_mountAssets(const char *path);
 void FILESYSTEM_unmountAssets(void);
+/* Loads the mounted assets again, after they've changed on disk */
+bool FILESYSTEM_reloadAssets(void);
+/* Where the mounted assets really are, folder or zip, or "" if none are */
+const char* FILESYSTEM_getAssetPath(void);
 bool FILESYSTEM_isAssetMounted(const char* filename);
 
 void FILESYSTEM_loadFileToMemory(const char *name, unsigned char **mem,
@@ -34,6 +51,10 @@ void FILESYSTEM_loadAssetToMemory(
 void FILESYSTEM_freeMemory(unsigned char **mem);
 
 bool FILESYSTEM_loadBinaryBlob(binaryBlob* blob, const char* filename);
+void FILESYSTEM_unmapFile(const char* mapping, size_t length);
+SDL_RWops* FILESYSTEM_openSliceRW(const char* path, int start, int size);
+
+bool FILESYSTEM_saveFile(const char* name, const void* data, size_t length);
 
 bool FILESYSTEM_saveTiXml2Document(const char *name, tinyxml2::XMLDocument& doc, bool sync = true);
 bool FILESYSTEM_loadTiXml2Document(const char *name, tinyxml2::XMLDocument& doc);
@@ -48,6 +69,10 @@ bool FILESYSTEM_openDirectoryEnabled(void);
 bool FILESYSTEM_openDirectory(const char *dname);
 
 bool FILESYSTEM_delete(const char *name);
+bool FILESYSTEM_createDirectory(const char *name);
+/* Sends everything the game writes to realDir instead of the user directory,
+ * which is left alone. What's written there shadows the user's own files. */
+bool FILESYSTEM_redirectWrites(const char* realDir);
 void FILESYSTEM_deleteLevelSaves(void);
 
 #endif /* FILESYSTEMUTILS_H */
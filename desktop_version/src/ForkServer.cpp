@@ -0,0 +1,420 @@
+#include "ForkServer.h"
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "DrawList.h"
+#include "Engine.h"
+#include "Entity.h"
+#include "Enums.h"
+#include "Exit.h"
+#include "FileSystemUtils.h"
+#include "Game.h"
+#include "Graphics.h"
+#include "KeyPoll.h"
+#include "RoomPrerender.h"
+#include "Script.h"
+#include "Vlogging.h"
+
+#if !defined(__EMSCRIPTEN__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__unix__))
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define HAVE_FORK
+#endif
+
+#ifdef HAVE_FORK
+
+/* Nobody has any business sending more than this */
+#define MAX_REQUEST (1 << 20)
+
+struct InputRun
+{
+    int frames;
+    unsigned int buttons;
+};
+
+static const struct
+{
+    char letter;
+    SDL_Keycode key;
+}
+buttons[] = {
+    {'L', KEYBOARD_LEFT},
+    {'R', KEYBOARD_RIGHT},
+    {'U', KEYBOARD_UP},
+    {'D', KEYBOARD_DOWN},
+    {'A', KEYBOARD_SPACE},
+    {'M', KEYBOARD_ENTER},
+    {'E', KEYBOARD_e},
+    {'X', SDLK_ESCAPE},
+    {'K', SDLK_r}
+};
+
+static bool parse_buttons(const std::string& text, unsigned int* held)
+{
+    *held = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        size_t button = 0;
+        while (button < SDL_arraysize(buttons) && buttons[button].letter != text[i])
+        {
+            button++;
+        }
+        if (button == SDL_arraysize(buttons))
+        {
+            return false;
+        }
+        *held |= 1 << button;
+    }
+    return true;
+}
+
+static bool parse_inputs(const std::string& text, std::vector<InputRun>* inputs)
+{
+    size_t start = 0;
+
+    while (start < text.size())
+    {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+
+        const std::string run = text.substr(start, end - start);
+        const size_t colon = run.find(':');
+        InputRun input;
+        if (colon == std::string::npos
+        || !ENGINE_parse_int(run.substr(0, colon), &input.frames)
+        || input.frames < 0
+        || !parse_buttons(run.substr(colon + 1), &input.buttons))
+        {
+            return false;
+        }
+        inputs->push_back(input);
+
+        start = end + 1;
+    }
+    return true;
+}
+
+static const char* const extra_keys[] = {"inputs", NULL};
+
+static bool parse_request(
+    const std::string& line,
+    PlaytestRequest* request,
+    std::vector<InputRun>* inputs,
+    std::string* error
+) {
+    if (!ENGINE_parse_playtest(line, extra_keys, request, error))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < request->extra.size(); i++)
+    {
+        /* The only one there can be */
+        const std::string& value = request->extra[i].second;
+        if (!parse_inputs(value, inputs))
+        {
+            *error = "bad inputs " + value;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool read_line(const int fd, std::string* line)
+{
+    char buffer[4096];
+
+    while (line->size() < MAX_REQUEST)
+    {
+        const ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            /* Let a request without the final newline through */
+            return !line->empty();
+        }
+
+        const char* newline = (const char*) memchr(buffer, '\n', got);
+        if (newline != NULL)
+        {
+            line->append(buffer, newline - buffer);
+            return true;
+        }
+        line->append(buffer, got);
+    }
+    return false;
+}
+
+static void reply(const int fd, const std::string& text)
+{
+    const std::string line = text + "\n";
+    size_t sent = 0;
+
+    while (sent < line.size())
+    {
+        const ssize_t wrote = write(fd, line.data() + sent, line.size() - sent);
+        if (wrote < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (wrote <= 0)
+        {
+            return;
+        }
+        sent += wrote;
+    }
+}
+
+static void set_buttons(const unsigned int held)
+{
+    for (size_t i = 0; i < SDL_arraysize(buttons); i++)
+    {
+        key.keymap[buttons[i].key] = (held & (1 << i)) != 0;
+    }
+}
+
+static void remove_tree(const std::string& path)
+{
+    struct stat info;
+
+    if (lstat(path.c_str(), &info) != 0)
+    {
+        return;
+    }
+    if (S_ISDIR(info.st_mode))
+    {
+        DIR* dir = opendir(path.c_str());
+        if (dir != NULL)
+        {
+            struct dirent* entry;
+            while ((entry = readdir(dir)) != NULL)
+            {
+                if (SDL_strcmp(entry->d_name, ".") != 0 && SDL_strcmp(entry->d_name, "..") != 0)
+                {
+                    remove_tree(path + "/" + entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(path.c_str());
+    }
+    else
+    {
+        unlink(path.c_str());
+    }
+}
+
+/* Makes a directory for the child to write its saves and level stats to, so
+ * runs don't fight over the player's files or change them */
+static bool make_scratch_dir(std::string* path)
+{
+    const char* tmp = SDL_getenv("TMPDIR");
+    const std::string name = std::string(tmp != NULL && tmp[0] != '\0' ? tmp : "/tmp")
+        + "/vvvvvv-forkserver-XXXXXX";
+    std::vector<char> buffer(name.begin(), name.end());
+
+    buffer.push_back('\0');
+    if (mkdtemp(&buffer[0]) == NULL)
+    {
+        vlog_error("Could not make a scratch directory: %s", strerror(errno));
+        return false;
+    }
+    *path = &buffer[0];
+
+    if (!FILESYSTEM_redirectWrites(path->c_str()))
+    {
+        remove_tree(*path);
+        return false;
+    }
+    return true;
+}
+
+/* Runs in the child */
+static void play(const int client)
+{
+    std::string line;
+    PlaytestRequest request;
+    std::vector<InputRun> inputs;
+    std::string error;
+
+    if (!read_line(client, &line))
+    {
+        reply(client, "error couldn't read request");
+        return;
+    }
+    if (!parse_request(line, &request, &inputs, &error))
+    {
+        reply(client, "error " + error);
+        return;
+    }
+    if (!ENGINE_start_playtest(request))
+    {
+        reply(client, "error level not found");
+        return;
+    }
+
+    key.isActive = true;
+    set_buttons(0);
+    ENGINE_begin();
+
+    int frames = 0;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        set_buttons(inputs[i].buttons);
+        for (int j = 0; j < inputs[i].frames; j++)
+        {
+            ENGINE_step();
+            frames++;
+        }
+    }
+
+    const int player = obj.getplayer();
+    int x = 0;
+    int y = 0;
+    if (INBOUNDS_VEC(player, obj.entities))
+    {
+        x = obj.entities[player].xp;
+        y = obj.entities[player].yp;
+    }
+
+    char result[256];
+    SDL_snprintf(
+        result,
+        sizeof(result),
+        "ok frames=%i gamestate=%i rx=%i ry=%i x=%i y=%i deaths=%i trinkets=%i crewmates=%i dying=%i",
+        frames,
+        game.gamestate,
+        game.roomx,
+        game.roomy,
+        x,
+        y,
+        game.deathcounts,
+        game.trinkets(),
+        game.crewmates(),
+        game.deathseq != -1
+    );
+    reply(client, result);
+}
+
+void FORKSERVER_run(const char* path)
+{
+    struct sockaddr_un address;
+    int server;
+
+    SDL_zero(address);
+    address.sun_family = AF_UNIX;
+    if (SDL_strlen(path) >= sizeof(address.sun_path))
+    {
+        vlog_error("Fork server socket path is too long: %s", path);
+        VVV_exit(1);
+    }
+    SDL_strlcpy(address.sun_path, path, sizeof(address.sun_path));
+
+    /* fork() only copies the calling thread, so nothing else can be running
+     * and maybe holding a lock the children will want. The children never
+     * draw, and SDL_mixer carries on quietly once its device is closed. */
+    DRAWLIST_quit();
+    PRERENDER_quit();
+    while (SDL_WasInit(SDL_INIT_AUDIO))
+    {
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+
+    /* Children clean up after themselves, and a client hanging up early
+     * shouldn't kill anything */
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+    {
+        vlog_error("Could not create fork server socket: %s", strerror(errno));
+        VVV_exit(1);
+    }
+    unlink(path);
+    if (bind(server, (struct sockaddr*) &address, sizeof(address)) != 0
+    || listen(server, SOMAXCONN) != 0)
+    {
+        vlog_error("Could not listen on %s: %s", path, strerror(errno));
+        close(server);
+        VVV_exit(1);
+    }
+
+    vlog_info("Fork server listening on %s", path);
+
+    while (true)
+    {
+        const int client = accept(server, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            vlog_error("Fork server could not accept: %s", strerror(errno));
+            break;
+        }
+
+        const pid_t child = fork();
+        if (child == 0)
+        {
+            std::string scratch;
+
+            close(server);
+            if (make_scratch_dir(&scratch))
+            {
+                play(client);
+                remove_tree(scratch);
+            }
+            else
+            {
+                reply(client, "error couldn't make a scratch directory");
+            }
+            close(client);
+
+            /* Skip static destructors and atexit(), which would tear down
+             * things that are still the parent's */
+            fflush(stdout);
+            fflush(stderr);
+            _exit(0);
+        }
+        if (child < 0)
+        {
+            vlog_error("Fork server could not fork: %s", strerror(errno));
+            reply(client, "error couldn't fork");
+        }
+        close(client);
+    }
+
+    close(server);
+    unlink(path);
+    VVV_exit(1);
+}
+
+#else /* HAVE_FORK */
+
+void FORKSERVER_run(const char* path)
+{
+    (void) path;
+
+    vlog_error("The fork server isn't supported on this platform.");
+    VVV_exit(1);
+}
+
+#endif /* HAVE_FORK */
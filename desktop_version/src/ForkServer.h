@@ -0,0 +1,21 @@
+#ifndef FORKSERVER_H
+#define FORKSERVER_H
+
+/* Listens on a UNIX socket at path and plays each request in its own fork()
+ * of this process, so every run starts with everything already loaded
+ * instead of paying for startup again. Call it once the game is fully
+ * initialized; it never returns.
+ *
+ * A request is one line in the format of PlaytestRequest (see Engine.h), with
+ * one more key:
+ *   inputs=RUNS        comma-separated FRAMES:BUTTONS runs, played in order,
+ *                      where BUTTONS is any of L R U D (directions), A (flip),
+ *                      M (map), E (interact), X (escape) and K (restart),
+ *                      e.g. "inputs=30:R,12:RA,60:"
+ * The reply is one line, either "ok" followed by key=value results or
+ * "error" followed by a message, and then the connection is closed. Anything
+ * a run saves goes to a scratch directory that's deleted afterwards, so the
+ * player's saves and level stats are never touched. */
+void FORKSERVER_run(const char* path);
+
+#endif /* FORKSERVER_H */
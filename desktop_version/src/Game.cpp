@@ -6791,14 +6791,14 @@ void Game::returntoeditor(void)
 
 static void returntoingametemp(void)
 {
-    extern Game game;
+    extern ENGINE_LOCAL Game& game;
     game.returntomenu(game.kludge_ingametemp);
 }
 
 #if !defined(NO_CUSTOM_LEVELS) && !defined(NO_EDITOR)
 static void returntoedsettings(void)
 {
-    extern Game game;
+    extern ENGINE_LOCAL Game& game;
     game.returntomenu(Menu::ed_settings);
 }
 #endif
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "EngineLocal.h"
 #include "ScreenSettings.h"
 
 /* FIXME: Can't forward declare this enum in C++, unfortunately.
@@ -490,7 +491,7 @@ public:
 };
 
 #ifndef GAME_DEFINITION
-extern Game game;
+extern ENGINE_LOCAL Game& game;
 #endif
 
 #endif /* GAME_H */
@@ -3,6 +3,8 @@
 #include <SDL_assert.h>
 #include <SDL_stdinc.h>
 
+#include "EngineLocal.h"
+
 #define LOOKUP_TABLE \
     FOREACH_ENUM(GlitchrunnerNone, "") \
     FOREACH_ENUM(Glitchrunner2_0, "2.0") \
@@ -46,7 +48,7 @@ enum GlitchrunnerMode GlitchrunnerMode_string_to_enum(const char* string)
 
 #undef LOOKUP_TABLE
 
-static enum GlitchrunnerMode current_mode = GlitchrunnerNone;
+static ENGINE_LOCAL enum GlitchrunnerMode current_mode = GlitchrunnerNone;
 
 void GlitchrunnerMode_set(const enum GlitchrunnerMode mode)
 {
@@ -4,14 +4,17 @@
 #include <SDL.h>
 #include <utf8/unchecked.h>
 
+#include "Blit.h"
 #include "Constants.h"
 #include "CustomLevels.h"
+#include "DrawList.h"
 #include "Entity.h"
 #include "Exit.h"
 #include "FileSystemUtils.h"
 #include "GraphicsUtil.h"
 #include "Map.h"
 #include "Music.h"
+#include "RoomPrerender.h"
 #include "Screen.h"
 #include "UtilityClass.h"
 #include "Vlogging.h"
@@ -19,6 +22,12 @@
 void Graphics::init(void)
 {
     flipmode = false;
+    text_run_bytes = 0;
+    text_run_clock = 0;
+    tower_strip_clock = 0;
+    tower_strips_version = -1;
+    tinted_generation = 0;
+    room_foreground_clock = 0;
     setRect(tiles_rect, 0,0,8,8);
     setRect(sprites_rect, 0,0,32,32);
     setRect(footerrect, 0, 230, 320, 10);
@@ -106,6 +115,8 @@ void Graphics::init(void)
     foregrounddrawn = false;
     foregroundBuffer = NULL;
     backgrounddrawn = false;
+    baseBuffer = NULL;
+    basedrawn = false;
     m = 0;
     linedelay = 0;
     menubuffer = NULL;
@@ -128,6 +139,17 @@ void Graphics::init(void)
     screenshake_x = 0;
     screenshake_y = 0;
 
+    framepending = false;
+    pendingshake = false;
+    pendingshake_x = 0;
+    pendingshake_y = 0;
+    pendingflipmode = false;
+    SDL_zero(pendingexport);
+
+    oldfilterscroll = 0;
+    filterscroll = 0;
+    filterscrolling = false;
+
     col_crewred = 0x00000000;
     col_crewyellow = 0x00000000;
     col_crewgreen = 0x00000000;
@@ -155,6 +177,9 @@ void Graphics::init(void)
 
 void Graphics::destroy(void)
 {
+    /* The prerender thread might still be using tiles */
+    clear_room_foregrounds();
+
     #define CLEAR_ARRAY(name) \
         for (size_t i = 0; i < name.size(); i += 1) \
         { \
@@ -173,6 +198,11 @@ void Graphics::destroy(void)
     CLEAR_ARRAY(flipbfont)
 
     #undef CLEAR_ARRAY
+
+    clear_text_runs();
+    clear_tinted();
+    clear_scaled();
+    clear_tower_strips();
 }
 
 void Graphics::create_buffers(const SDL_PixelFormat* fmt)
@@ -223,6 +253,10 @@ void Graphics::create_buffers(const SDL_PixelFormat* fmt)
     tempBuffer = CREATE_SURFACE(320, 240);
     SDL_SetSurfaceBlendMode(tempBuffer, SDL_BLENDMODE_NONE);
 
+    baseBuffer = CREATE_SURFACE(320, 240);
+    SDL_SetSurfaceBlendMode(baseBuffer, SDL_BLENDMODE_NONE);
+    basedrawn = false;
+
     #undef CREATE_SURFACE
 }
 
@@ -244,25 +278,36 @@ void Graphics::destroy_buffers(void)
     FREE_SURFACE(titlebg.buffer)
     FREE_SURFACE(titlebg.buffer_lerp)
     FREE_SURFACE(tempBuffer)
+    FREE_SURFACE(baseBuffer)
 
 #undef FREE_SURFACE
 }
 
+#define FONT_PAGE_SIZE 256
+#define FONT_NUM_PAGES (0x110000 / FONT_PAGE_SIZE)
+
 int Graphics::font_idx(uint32_t ch)
 {
-    if (font_positions.size() > 0)
+    if (font_page_index.size() > 0)
     {
-        std::map<int, int>::iterator iter = font_positions.find(ch);
-        if (iter == font_positions.end())
+        int idx;
+        if (ch < FONT_NUM_PAGES * FONT_PAGE_SIZE)
         {
-            iter = font_positions.find('?');
-            if (iter == font_positions.end())
-            {
-                WHINE_ONCE("font.txt missing fallback character!");
-                return -1;
-            }
+            idx = font_pages[
+                font_page_index[ch / FONT_PAGE_SIZE] * FONT_PAGE_SIZE
+                + ch % FONT_PAGE_SIZE
+            ];
+        }
+        else
+        {
+            /* Page 0 is all fallback */
+            idx = font_pages[0];
+        }
+        if (idx == -1)
+        {
+            WHINE_ONCE("font.txt missing fallback character!");
         }
-        return iter->second;
+        return idx;
     }
     else
     {
@@ -364,28 +409,57 @@ bool Graphics::Makebfont(void)
 
     unsigned char* charmap;
     size_t length;
+
+    font_page_index.clear();
+    font_pages.clear();
+
     FILESYSTEM_loadAssetToMemory("graphics/font.txt", &charmap, &length, false);
     if (charmap != NULL)
     {
+        std::vector<uint32_t> codepoints;
         unsigned char* current = charmap;
         unsigned char* end = charmap + length;
-        int pos = 0;
+        int fallback = -1;
         while (current != end)
         {
-            int codepoint = utf8::unchecked::next(current);
-            font_positions[codepoint] = pos;
-            ++pos;
+            uint32_t codepoint = utf8::unchecked::next(current);
+            if (codepoint == '?')
+            {
+                fallback = codepoints.size();
+            }
+            codepoints.push_back(codepoint);
         }
         FILESYSTEM_freeMemory(&charmap);
-    }
-    else
-    {
-        font_positions.clear();
+
+        font_page_index.resize(FONT_NUM_PAGES, 0);
+        font_pages.resize(FONT_PAGE_SIZE, fallback);
+
+        for (size_t pos = 0; pos < codepoints.size(); ++pos)
+        {
+            const uint32_t codepoint = codepoints[pos];
+            const uint32_t page = codepoint / FONT_PAGE_SIZE;
+            if (page >= FONT_NUM_PAGES)
+            {
+                continue;
+            }
+            if (font_page_index[page] == 0)
+            {
+                font_page_index[page] = font_pages.size() / FONT_PAGE_SIZE;
+                font_pages.resize(font_pages.size() + FONT_PAGE_SIZE, fallback);
+            }
+            font_pages[
+                font_page_index[page] * FONT_PAGE_SIZE
+                + codepoint % FONT_PAGE_SIZE
+            ] = pos;
+        }
     }
 
     return true;
 }
 
+#undef FONT_NUM_PAGES
+#undef FONT_PAGE_SIZE
+
 int Graphics::bfontlen(uint32_t ch)
 {
     if (ch < 32)
@@ -502,10 +576,244 @@ static void print_char(
 
     if (scale > 1)
     {
+        DRAWLIST_sync(surface);
         SDL_FreeSurface(surface);
     }
 }
 
+#define TEXT_RUN_MAX_RUNS 256
+#define TEXT_RUN_MAX_BYTES (4 * 1024 * 1024)
+
+/* Returns the whole of text rendered in white, to be drawn with
+ * BlitSurfaceColoured(), or NULL if it has to be printed glyph by glyph */
+SDL_Surface* Graphics::get_text_run(const std::string& text, const int scale)
+{
+    std::vector<SDL_Surface*>& font = flipmode ? flipbfont : bfont;
+    std::map<TextRunKey, TextRun>::iterator it;
+    std::string::const_iterator iter;
+    TextRunKey key;
+    TextRun run;
+    colourTransform white;
+    int width = 0;
+    int position = 0;
+    size_t bytes;
+
+    if (font.empty())
+    {
+        return NULL;
+    }
+
+    key.text = text;
+    key.scale = scale;
+    key.flipped = flipmode;
+
+    it = text_runs.find(key);
+    if (it != text_runs.end())
+    {
+        it->second.last_used = ++text_run_clock;
+        return it->second.surface;
+    }
+
+    /* Copying overlapping glyphs into one surface wouldn't look the same as
+     * blending them one after the other, so leave those strings alone */
+    iter = text.begin();
+    while (iter != text.end())
+    {
+        const uint32_t character = utf8::unchecked::next(iter);
+
+        if (bfontlen(character) < 8)
+        {
+            return NULL;
+        }
+        if (INBOUNDS_VEC(font_idx(character), font))
+        {
+            width = position + 8 * scale;
+        }
+
+        position += 8 * scale;
+    }
+
+    if (width == 0)
+    {
+        return NULL;
+    }
+
+    run.surface = SDL_CreateRGBSurface(
+        SDL_SWSURFACE,
+        width,
+        8 * scale,
+        font[0]->format->BitsPerPixel,
+        font[0]->format->Rmask,
+        font[0]->format->Gmask,
+        font[0]->format->Bmask,
+        font[0]->format->Amask
+    );
+    if (run.surface == NULL)
+    {
+        return NULL;
+    }
+    {
+        SDL_BlendMode blend_mode;
+        SDL_GetSurfaceBlendMode(font[0], &blend_mode);
+        SDL_SetSurfaceBlendMode(run.surface, blend_mode);
+    }
+
+    /* Colouring this again with c gives the same pixels as colouring the
+     * glyphs with c straight away */
+    white.colour = 0xFFFFFFFF;
+
+    position = 0;
+    iter = text.begin();
+    while (iter != text.end())
+    {
+        const uint32_t character = utf8::unchecked::next(iter);
+        const int idx = font_idx(character);
+
+        if (INBOUNDS_VEC(idx, font))
+        {
+            if (scale > 1)
+            {
+                SDL_Surface* scaled = ScaleSurface(font[idx], 8 * scale, 8 * scale);
+                if (scaled != NULL)
+                {
+                    DrawSurfaceColoured(scaled, run.surface, position, 0, white);
+                    SDL_FreeSurface(scaled);
+                }
+            }
+            else
+            {
+                DrawSurfaceColoured(font[idx], run.surface, position, 0, white);
+            }
+        }
+
+        position += bfontlen(character) * scale;
+    }
+
+    bytes = run.surface->pitch * run.surface->h;
+
+    while (!text_runs.empty()
+    && (text_runs.size() >= TEXT_RUN_MAX_RUNS
+    || text_run_bytes + bytes > TEXT_RUN_MAX_BYTES))
+    {
+        std::map<TextRunKey, TextRun>::iterator oldest = text_runs.begin();
+        for (it = text_runs.begin(); it != text_runs.end(); ++it)
+        {
+            if (it->second.last_used < oldest->second.last_used)
+            {
+                oldest = it;
+            }
+        }
+
+        text_run_bytes -= oldest->second.surface->pitch * oldest->second.surface->h;
+        DRAWLIST_sync(oldest->second.surface);
+        SDL_FreeSurface(oldest->second.surface);
+        text_runs.erase(oldest);
+    }
+
+    run.last_used = ++text_run_clock;
+    text_runs[key] = run;
+    text_run_bytes += bytes;
+
+    return run.surface;
+}
+
+#undef TEXT_RUN_MAX_BYTES
+#undef TEXT_RUN_MAX_RUNS
+
+void Graphics::clear_text_runs(void)
+{
+    std::map<TextRunKey, TextRun>::iterator it;
+
+    for (it = text_runs.begin(); it != text_runs.end(); ++it)
+    {
+        DRAWLIST_sync(it->second.surface);
+        SDL_FreeSurface(it->second.surface);
+    }
+    text_runs.clear();
+    text_run_bytes = 0;
+}
+
+/* Anything past this is probably cycling colours, so start over */
+#define TINTED_MAX_SURFACES 1024
+
+SDL_Surface* Graphics::get_tinted(SDL_Surface* surface, const Uint32 colour)
+{
+    const std::pair<SDL_Surface*, Uint32> key(surface, colour);
+    std::map<std::pair<SDL_Surface*, Uint32>, SDL_Surface*>::iterator it;
+    colourTransform tint;
+    SDL_Surface* tinted;
+
+    it = tinted_surfaces.find(key);
+    if (it != tinted_surfaces.end())
+    {
+        return it->second;
+    }
+
+    if (tinted_surfaces.size() >= TINTED_MAX_SURFACES)
+    {
+        clear_tinted();
+    }
+
+    tint.colour = colour;
+    tinted = TintSurface(surface, tint);
+    if (tinted != NULL)
+    {
+        tinted_surfaces[key] = tinted;
+    }
+    return tinted;
+}
+
+#undef TINTED_MAX_SURFACES
+
+void Graphics::clear_tinted(void)
+{
+    std::map<std::pair<SDL_Surface*, Uint32>, SDL_Surface*>::iterator it;
+
+    /* Cached foregrounds are keyed by tile surface, and a new tinted tile
+     * could end up at the same address as one freed here */
+    clear_room_foregrounds();
+
+    for (it = tinted_surfaces.begin(); it != tinted_surfaces.end(); ++it)
+    {
+        DRAWLIST_sync(it->second);
+        SDL_FreeSurface(it->second);
+    }
+    tinted_surfaces.clear();
+    tinted_generation++;
+}
+
+SDL_Surface* Graphics::get_scaled(SDL_Surface* surface, const int scale)
+{
+    const std::pair<SDL_Surface*, int> key(surface, scale);
+    std::map<std::pair<SDL_Surface*, int>, SDL_Surface*>::iterator it;
+    SDL_Surface* scaled;
+
+    it = scaled_surfaces.find(key);
+    if (it != scaled_surfaces.end())
+    {
+        return it->second;
+    }
+
+    scaled = ScaleSurfaceInteger(surface, scale);
+    if (scaled != NULL)
+    {
+        scaled_surfaces[key] = scaled;
+    }
+    return scaled;
+}
+
+void Graphics::clear_scaled(void)
+{
+    std::map<std::pair<SDL_Surface*, int>, SDL_Surface*>::iterator it;
+
+    for (it = scaled_surfaces.begin(); it != scaled_surfaces.end(); ++it)
+    {
+        DRAWLIST_sync(it->second);
+        SDL_FreeSurface(it->second);
+    }
+    scaled_surfaces.clear();
+}
+
 void Graphics::do_print(
     const int x,
     const int y,
@@ -528,6 +836,14 @@ void Graphics::do_print(
 
     ct.colour = getRGBA(r, g, b, a);
 
+    SDL_Surface* run = get_text_run(text, scale);
+    if (run != NULL)
+    {
+        SDL_Rect run_rect = {x, y, run->w, run->h};
+        BlitSurfaceColoured(run, NULL, backBuffer, &run_rect, ct);
+        return;
+    }
+
     while (iter != text.end())
     {
         const uint32_t character = utf8::unchecked::next(iter);
@@ -877,8 +1193,7 @@ void Graphics::drawtile( int x, int y, int t )
 #if !defined(NO_CUSTOM_LEVELS)
     if (shouldrecoloroneway(t, tiles1_mounted))
     {
-        colourTransform thect = {cl.getonewaycol()};
-        BlitSurfaceTinted(tiles[t], NULL, backBuffer, &rect, thect);
+        BlitSurfaceStandard(get_tinted(tiles[t], cl.getonewaycol()), NULL, backBuffer, &rect);
     }
     else
 #endif
@@ -901,8 +1216,7 @@ void Graphics::drawtile2( int x, int y, int t )
 #if !defined(NO_CUSTOM_LEVELS)
     if (shouldrecoloroneway(t, tiles2_mounted))
     {
-        colourTransform thect = {cl.getonewaycol()};
-        BlitSurfaceTinted(tiles2[t], NULL, backBuffer, &rect, thect);
+        BlitSurfaceStandard(get_tinted(tiles2[t], cl.getonewaycol()), NULL, backBuffer, &rect);
     }
     else
 #endif
@@ -1815,18 +2129,23 @@ void Graphics::drawentities(void)
 {
     const int yoff = map.towermode ? lerp(map.oldypos, map.ypos) : 0;
 
+    /* Disabled entities are invisible, so only the live ones are drawn */
+    const std::vector<int>& live = obj.liveentities;
+
     if (!map.custommode)
     {
-        for (int i = obj.entities.size() - 1; i >= 0; i--)
+        for (int l = live.size() - 1; l >= 0; l--)
         {
+            const int i = live[l];
             if (!obj.entities[i].ishumanoid())
             {
                 drawentity(i, yoff);
             }
         }
 
-        for (int i = obj.entities.size() - 1; i >= 0; i--)
+        for (int l = live.size() - 1; l >= 0; l--)
         {
+            const int i = live[l];
             if (obj.entities[i].ishumanoid())
             {
                 drawentity(i, yoff);
@@ -1835,9 +2154,9 @@ void Graphics::drawentities(void)
     }
     else
     {
-        for (int i = obj.entities.size() - 1; i >= 0; i--)
+        for (int l = live.size() - 1; l >= 0; l--)
         {
-            drawentity(i, yoff);
+            drawentity(live[l], yoff);
         }
     }
 }
@@ -1981,9 +2300,7 @@ void Graphics::drawentity(const int i, const int yoff)
             drawRect.x += 8 * ii;
             if (custom_gray)
             {
-                colourTransform temp_ct;
-                temp_ct.colour = 0xFFFFFFFF;
-                BlitSurfaceTinted(tilesvec[obj.entities[i].drawframe],NULL, backBuffer, &drawRect, temp_ct);
+                BlitSurfaceStandard(get_tinted(tilesvec[obj.entities[i].drawframe], 0xFFFFFFFF), NULL, backBuffer, &drawRect);
             }
             else
             {
@@ -2177,9 +2494,11 @@ void Graphics::drawentity(const int i, const int yoff)
         tpoint.x = xp; tpoint.y = yp - yoff;
         setcolreal(obj.entities[i].realcol);
         setRect(drawRect, xp, yp - yoff, sprites_rect.x * 6, sprites_rect.y * 6);
-        SDL_Surface* TempSurface = ScaleSurface( spritesvec[obj.entities[i].drawframe], 6 * sprites_rect.w,6* sprites_rect.h );
-        BlitSurfaceColoured(TempSurface, NULL , backBuffer,  &drawRect, ct );
-        SDL_FreeSurface(TempSurface);
+        SDL_Surface* TempSurface = get_scaled(spritesvec[obj.entities[i].drawframe], 6);
+        if (TempSurface != NULL)
+        {
+            BlitSurfaceColoured(TempSurface, NULL , backBuffer,  &drawRect, ct );
+        }
 
 
 
@@ -2372,9 +2691,9 @@ void Graphics::drawbackground( int t )
         break;
     case 4: //Warp zone (vertical)
         ClearSurface(backBuffer);
-        SDL_BlitSurface(warpbuffer, NULL, warpbuffer_lerp, NULL);
+        BlitSurfaceStandard(warpbuffer, NULL, warpbuffer_lerp, NULL);
         ScrollSurface(warpbuffer_lerp, 0, lerp(0, -3));
-        SDL_BlitSurface(warpbuffer_lerp, &towerbuffer_rect, backBuffer, NULL);
+        BlitSurfaceStandard(warpbuffer_lerp, &towerbuffer_rect, backBuffer, NULL);
         break;
     case 5:
         //Warp zone, central
@@ -2653,102 +2972,508 @@ void Graphics::drawmap(void)
 {
     if (!foregrounddrawn)
     {
-        ClearSurface(foregroundBuffer);
-        if(map.tileset==0)
+        drawforeground(false);
+        foregrounddrawn = true;
+    }
+    BlitSurfaceStandard(foregroundBuffer, NULL, backBuffer, NULL);
+
+}
+
+void Graphics::drawfinalmap(void)
+{
+    if (!foregrounddrawn) {
+        drawforeground(true);
+        foregrounddrawn=true;
+    }
+
+    BlitSurfaceStandard(foregroundBuffer, NULL, backBuffer, NULL);
+}
+
+static Uint64 hash_cells(const std::vector<SDL_Surface*>& cells)
+{
+    /* FNV-1a */
+    Uint64 hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        const Uint64 value = (Uint64) (size_t) cells[i];
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            hash ^= (value >> shift) & 0xFF;
+            hash *= 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+#define ROOM_FOREGROUND_MAX_ROOMS 32
+
+/* Takes ownership of surface */
+static void store_room_foreground(
+    std::map<Uint64, Graphics::RoomForeground>& room_foregrounds,
+    const Uint64 key,
+    const std::vector<SDL_Surface*>& cells,
+    SDL_Surface* surface,
+    const Uint32 last_used
+) {
+    std::map<Uint64, Graphics::RoomForeground>::iterator it = room_foregrounds.find(key);
+    if (it != room_foregrounds.end())
+    {
+        SDL_FreeSurface(it->second.surface);
+        room_foregrounds.erase(it);
+    }
+
+    while (room_foregrounds.size() >= ROOM_FOREGROUND_MAX_ROOMS)
+    {
+        std::map<Uint64, Graphics::RoomForeground>::iterator oldest = room_foregrounds.begin();
+        for (it = room_foregrounds.begin(); it != room_foregrounds.end(); ++it)
         {
-            for (int j = 0; j < 30; j++)
+            if (it->second.last_used < oldest->second.last_used)
             {
-                for (int i = 0; i < 40; i++)
-                {
-                    const int tile = map.contents[TILE_IDX(i, j)];
-                    if(tile>0) drawforetile(i * 8, j * 8, tile);
-                }
+                oldest = it;
             }
         }
-        else if (map.tileset == 1)
+
+        SDL_FreeSurface(oldest->second.surface);
+        room_foregrounds.erase(oldest);
+    }
+
+    Graphics::RoomForeground& room = room_foregrounds[key];
+    room.cells = cells;
+    room.surface = surface;
+    room.last_used = last_used;
+}
+
+#undef ROOM_FOREGROUND_MAX_ROOMS
+
+static SDL_Surface* create_foreground_like(SDL_Surface* foreground)
+{
+    SDL_Surface* surface = SDL_CreateRGBSurface(
+        SDL_SWSURFACE,
+        foreground->w,
+        foreground->h,
+        foreground->format->BitsPerPixel,
+        foreground->format->Rmask,
+        foreground->format->Gmask,
+        foreground->format->Bmask,
+        foreground->format->Amask
+    );
+    if (surface != NULL)
+    {
+        SDL_BlendMode blend_mode;
+        SDL_GetSurfaceBlendMode(foreground, &blend_mode);
+        SDL_SetSurfaceBlendMode(surface, blend_mode);
+    }
+    return surface;
+}
+
+void Graphics::drawforeground(const bool final)
+{
+    std::map<Uint64, RoomForeground>::iterator it;
+    PrerenderedRoom prerendered;
+    Uint32 onewaycol = 0;
+    int generation;
+    Uint64 key;
+
+    while (PRERENDER_collect(&prerendered))
+    {
+        if (prerendered.ok)
+        {
+            store_room_foreground(
+                room_foregrounds,
+                prerendered.key,
+                prerendered.cells,
+                prerendered.surface,
+                ++room_foreground_clock
+            );
+        }
+        else
+        {
+            SDL_FreeSurface(prerendered.surface);
+        }
+    }
+
+#if !defined(NO_CUSTOM_LEVELS)
+    onewaycol = cl.getonewaycol();
+#endif
+
+    /* Work out which surface goes in each cell first, then draw them. Going
+     * over the limit of tinted tiles halfway through would free the ones
+     * we've already got, so start again if that happens. */
+    foreground_cells.assign(SCREEN_WIDTH_TILES * SCREEN_HEIGHT_TILES, NULL);
+    do
+    {
+        generation = tinted_generation;
+        for (int j = 0; j < SCREEN_HEIGHT_TILES; j++)
         {
-            for (int jt = 0; jt < 30; jt++)
+            for (int i = 0; i < SCREEN_WIDTH_TILES; i++)
             {
-                for (int it = 0; it < 40; it++)
+                const int tile = map.contents[TILE_IDX(i, j)];
+                SDL_Surface** cell = &foreground_cells[TILE_IDX(i, j)];
+                if (tile <= 0)
+                {
+                    continue;
+                }
+
+                if (!final)
                 {
-                    const int tile = map.contents[TILE_IDX(it, jt)];
-                    if(tile>0) drawforetile2(it * 8, jt * 8, tile);
+                    *cell = getforetile(map.tileset, tile, map.rcol, onewaycol);
+                }
+                else if (map.tileset == 0 || map.tileset == 1)
+                {
+                    *cell = getforetile(map.tileset, map.finalat(i, j), 0, onewaycol);
                 }
             }
         }
-        else if (map.tileset == 2)
+    }
+    while (generation != tinted_generation);
+
+    key = hash_cells(foreground_cells);
+    it = room_foregrounds.find(key);
+    if (it != room_foregrounds.end() && it->second.cells == foreground_cells)
+    {
+        it->second.last_used = ++room_foreground_clock;
+        DRAWLIST_sync(foregroundBuffer);
+        BlitReplace(it->second.surface, foregroundBuffer, 0, 0);
+        return;
+    }
+
+    ClearSurface(foregroundBuffer);
+    for (int j = 0; j < SCREEN_HEIGHT_TILES; j++)
+    {
+        BlitSurfaceRow(
+            &foreground_cells[TILE_IDX(0, j)],
+            SCREEN_WIDTH_TILES,
+            8,
+            foregroundBuffer,
+            0,
+            j * 8
+        );
+    }
+
+    /* Keep a copy in case we come back here */
+    SDL_Surface* copy = create_foreground_like(foregroundBuffer);
+    if (copy != NULL)
+    {
+        BlitReplace(foregroundBuffer, copy, 0, 0);
+        store_room_foreground(room_foregrounds, key, foreground_cells, copy, ++room_foreground_clock);
+    }
+}
+
+void Graphics::prerenderneighbours(void)
+{
+#if !defined(NO_CUSTOM_LEVELS)
+    /* Only custom levels are simple enough to know what's in a room without
+     * actually loading it */
+    if (!map.custommode
+    || map.towermode
+    || map.final_colormode
+    || foregroundBuffer == NULL
+    || cl.mapwidth <= 0
+    || cl.mapheight <= 0)
+    {
+        return;
+    }
+
+    const int rx = game.roomx - 100;
+    const int ry = game.roomy - 100;
+    int px = SCREEN_WIDTH_PIXELS / 2;
+    int py = SCREEN_HEIGHT_PIXELS / 2;
+    const int player = obj.getplayer();
+    if (INBOUNDS_VEC(player, obj.entities))
+    {
+        px = obj.entities[player].xp;
+        py = obj.entities[player].yp;
+    }
+
+    /* Screen wrapping keeps us in the same room, so only neighbours we can
+     * walk into, nearest edge to the player first */
+    struct Neighbour
+    {
+        int rx;
+        int ry;
+        int distance;
+    };
+    Neighbour neighbours[4];
+    int num_neighbours = 0;
+    if (!map.warpx)
+    {
+        Neighbour left = {rx - 1, ry, px};
+        Neighbour right = {rx + 1, ry, SCREEN_WIDTH_PIXELS - px};
+        neighbours[num_neighbours++] = left;
+        neighbours[num_neighbours++] = right;
+    }
+    if (!map.warpy)
+    {
+        Neighbour up = {rx, ry - 1, py};
+        Neighbour down = {rx, ry + 1, SCREEN_HEIGHT_PIXELS - py};
+        neighbours[num_neighbours++] = up;
+        neighbours[num_neighbours++] = down;
+    }
+    for (int i = 1; i < num_neighbours; i++)
+    {
+        for (int j = i; j > 0 && neighbours[j].distance < neighbours[j - 1].distance; j--)
+        {
+            const Neighbour swap = neighbours[j];
+            neighbours[j] = neighbours[j - 1];
+            neighbours[j - 1] = swap;
+        }
+    }
+
+    for (int n = 0; n < num_neighbours; n++)
+    {
+        const int nx = POS_MOD(neighbours[n].rx, cl.mapwidth);
+        const int ny = POS_MOD(neighbours[n].ry, cl.mapheight);
+        if (nx == rx && ny == ry)
+        {
+            continue;
+        }
+
+        /* Same tileset choice as mapclass::loadlevel() */
+        const RoomProperty* const room = cl.getroomprop(nx, ny);
+        const int tileset = room->tileset == 0 ? 0 : 1;
+        const Uint32 onewaycol = cl.getonewaycol(nx, ny);
+        int generation;
+
+        foreground_cells.assign(SCREEN_WIDTH_TILES * SCREEN_HEIGHT_TILES, NULL);
+        do
         {
-            for (int j = 0; j < 30; j++)
+            generation = tinted_generation;
+            for (int j = 0; j < SCREEN_HEIGHT_TILES; j++)
             {
-                for (int i = 0; i < 40; i++)
+                for (int i = 0; i < SCREEN_WIDTH_TILES; i++)
                 {
-                    const int tile = map.contents[TILE_IDX(i, j)];
-                    if(tile>0) drawforetile3(i * 8, j * 8, tile,map.rcol);
+                    const int tile = cl.gettile(nx, ny, i, j);
+                    if (tile > 0)
+                    {
+                        foreground_cells[TILE_IDX(i, j)] = getforetile(tileset, tile, 0, onewaycol);
+                    }
                 }
             }
         }
-        foregrounddrawn = true;
+        while (generation != tinted_generation);
+
+        const Uint64 key = hash_cells(foreground_cells);
+        std::map<Uint64, RoomForeground>::iterator it = room_foregrounds.find(key);
+        if (it != room_foregrounds.end() && it->second.cells == foreground_cells)
+        {
+            it->second.last_used = ++room_foreground_clock;
+            continue;
+        }
+
+        SDL_Surface* surface = create_foreground_like(foregroundBuffer);
+        if (!PRERENDER_queue(key, foreground_cells, surface))
+        {
+            SDL_FreeSurface(surface);
+            return;
+        }
     }
-    SDL_BlitSurface(foregroundBuffer, NULL, backBuffer, NULL);
+#endif
+}
+
+void Graphics::clear_room_foregrounds(void)
+{
+    std::map<Uint64, RoomForeground>::iterator it;
+
+    PRERENDER_cancel();
 
+    for (it = room_foregrounds.begin(); it != room_foregrounds.end(); ++it)
+    {
+        SDL_FreeSurface(it->second.surface);
+    }
+    room_foregrounds.clear();
 }
 
-void Graphics::drawfinalmap(void)
+enum TowerStripSet
 {
-    if (!foregrounddrawn) {
-        ClearSurface(foregroundBuffer);
-        if(map.tileset==0){
-            for (int j = 0; j < 30; j++) {
-                for (int i = 0; i < 40; i++) {
-                    if((map.contents[TILE_IDX(i, j)])>0)
-                        drawforetile(i * 8, j * 8, map.finalat(i,j));
-                }
+    TOWER_STRIP_MAIN,
+    TOWER_STRIP_MINI,
+    TOWER_STRIP_SPIKES_TOP,
+    TOWER_STRIP_SPIKES_BOTTOM
+};
+
+/* Both 700 and 100 (the minitowers) are multiples of this, so strips never
+ * straddle the point where the tower wraps around */
+#define TOWER_STRIP_ROWS 5
+#define TOWER_STRIP_MAX_STRIPS 256
+
+SDL_Surface* Graphics::get_tower_strip(const int colstate, const int which, const int index)
+{
+    TowerStripKey key;
+    std::map<TowerStripKey, TowerStrip>::iterator it;
+    TowerStrip strip;
+    SDL_BlendMode blend_mode;
+    int rows;
+
+    if (tower_strips_version != map.tower.version)
+    {
+        clear_tower_strips();
+        tower_strips_version = map.tower.version;
+    }
+
+    key.colstate = colstate;
+    key.which = which;
+    key.index = index;
+
+    it = tower_strips.find(key);
+    if (it != tower_strips.end())
+    {
+        it->second.last_used = ++tower_strip_clock;
+        return it->second.surface;
+    }
+
+    if (tiles3.empty())
+    {
+        return NULL;
+    }
+
+    rows = (which == TOWER_STRIP_MAIN || which == TOWER_STRIP_MINI) ? TOWER_STRIP_ROWS : 1;
+
+    strip.surface = SDL_CreateRGBSurface(
+        SDL_SWSURFACE,
+        40 * 8,
+        rows * 8,
+        tiles3[0]->format->BitsPerPixel,
+        tiles3[0]->format->Rmask,
+        tiles3[0]->format->Gmask,
+        tiles3[0]->format->Bmask,
+        tiles3[0]->format->Amask
+    );
+    if (strip.surface == NULL)
+    {
+        return NULL;
+    }
+    SDL_GetSurfaceBlendMode(tiles3[0], &blend_mode);
+    SDL_SetSurfaceBlendMode(strip.surface, blend_mode);
+
+    /* Tiles don't overlap, so copying them into a blank strip and blending
+     * the strip later draws the same as blending each tile */
+    for (int j = 0; j < rows; j++)
+    {
+        const int row = index * rows + j;
+        for (int i = 0; i < 40; i++)
+        {
+            int t;
+            switch (which)
+            {
+            case TOWER_STRIP_MAIN:
+                t = map.tower.contents[TILE_IDX(i, row)];
+                break;
+            case TOWER_STRIP_MINI:
+                t = map.tower.minitower[TILE_IDX(i, row)];
+                break;
+            case TOWER_STRIP_SPIKES_TOP:
+                t = 9;
+                break;
+            default:
+                t = 8;
+                break;
             }
-        }else if (map.tileset == 1) {
-            for (int j = 0; j < 30; j++) {
-                for (int i = 0; i < 40; i++) {
-                    if((map.contents[TILE_IDX(i, j)])>0)
-                        drawforetile2(i * 8, j * 8, map.finalat(i,j));
-                }
+            if (t <= 0)
+            {
+                continue;
+            }
+
+            t += colstate * 30;
+            if (!INBOUNDS_VEC(t, tiles3))
+            {
+                WHINE_ONCE("get_tower_strip() out-of-bounds!");
+                continue;
             }
+            BlitReplace(tiles3[t], strip.surface, i * 8, j * 8);
         }
-        foregrounddrawn=true;
     }
 
-    SDL_BlitSurface(foregroundBuffer, NULL, backBuffer, NULL);
+    if (tower_strips.size() >= TOWER_STRIP_MAX_STRIPS)
+    {
+        std::map<TowerStripKey, TowerStrip>::iterator oldest = tower_strips.begin();
+        for (it = tower_strips.begin(); it != tower_strips.end(); ++it)
+        {
+            if (it->second.last_used < oldest->second.last_used)
+            {
+                oldest = it;
+            }
+        }
+
+        DRAWLIST_sync(oldest->second.surface);
+        SDL_FreeSurface(oldest->second.surface);
+        tower_strips.erase(oldest);
+    }
+
+    strip.last_used = ++tower_strip_clock;
+    tower_strips[key] = strip;
+
+    return strip.surface;
+}
+
+#undef TOWER_STRIP_MAX_STRIPS
+
+void Graphics::clear_tower_strips(void)
+{
+    std::map<TowerStripKey, TowerStrip>::iterator it;
+
+    for (it = tower_strips.begin(); it != tower_strips.end(); ++it)
+    {
+        DRAWLIST_sync(it->second.surface);
+        SDL_FreeSurface(it->second.surface);
+    }
+    tower_strips.clear();
 }
 
 void Graphics::drawtowermap(void)
 {
-    int temp;
-    int yoff = lerp(map.oldypos, map.ypos);
-    for (int j = 0; j < 31; j++)
+    const int yoff = lerp(map.oldypos, map.ypos);
+    const int first_row = yoff / 8;
+    const int num_rows = map.tower.minitowermode ? 100 : 700;
+    const int which = map.tower.minitowermode ? TOWER_STRIP_MINI : TOWER_STRIP_MAIN;
+
+    /* 31 rows of tiles, starting from wherever the top of the screen is */
+    int row = first_row;
+    while (row < first_row + 31)
     {
-        for (int i = 0; i < 40; i++)
+        const int wrapped = POS_MOD(row, num_rows);
+        const int strip_row = wrapped % TOWER_STRIP_ROWS;
+        const int count = SDL_min(TOWER_STRIP_ROWS - strip_row, first_row + 31 - row);
+        SDL_Surface* strip = get_tower_strip(towerbg.colstate, which, wrapped / TOWER_STRIP_ROWS);
+
+        if (strip != NULL)
         {
-            temp = map.tower.at(i, j, yoff);
-            if (temp > 0) drawtile3(i * 8, (j * 8) - (yoff % 8), temp, towerbg.colstate);
+            SDL_Rect src_rect = {0, strip_row * 8, strip->w, count * 8};
+            SDL_Rect rect = {0, (row - first_row) * 8 - (yoff % 8), 0, 0};
+            BlitSurfaceStandard(strip, &src_rect, backBuffer, &rect);
         }
+
+        row += count;
     }
 }
 
+#undef TOWER_STRIP_ROWS
+
 void Graphics::drawtowerspikes(void)
 {
     int spikeleveltop = lerp(map.oldspikeleveltop, map.spikeleveltop);
     int spikelevelbottom = lerp(map.oldspikelevelbottom, map.spikelevelbottom);
-    for (int i = 0; i < 40; i++)
+    SDL_Surface* top = get_tower_strip(towerbg.colstate, TOWER_STRIP_SPIKES_TOP, 0);
+    SDL_Surface* bottom = get_tower_strip(towerbg.colstate, TOWER_STRIP_SPIKES_BOTTOM, 0);
+
+    if (top != NULL)
+    {
+        SDL_Rect rect = {0, -8 + spikeleveltop, 0, 0};
+        BlitSurfaceStandard(top, NULL, backBuffer, &rect);
+    }
+    if (bottom != NULL)
     {
-        drawtile3(i * 8, -8+spikeleveltop, 9, towerbg.colstate);
-        drawtile3(i * 8, 230-spikelevelbottom, 8, towerbg.colstate, 8 - spikelevelbottom);
+        SDL_Rect src_rect = {0, 0, bottom->w, spikelevelbottom};
+        SDL_Rect rect = {0, 230 - spikelevelbottom, 0, 0};
+        BlitSurfaceStandard(bottom, &src_rect, backBuffer, &rect);
     }
 }
 
 void Graphics::drawtowerbackground(const TowerBG& bg_obj)
 {
     ClearSurface(backBuffer);
-    SDL_BlitSurface(bg_obj.buffer, NULL, bg_obj.buffer_lerp, NULL);
+    BlitSurfaceStandard(bg_obj.buffer, NULL, bg_obj.buffer_lerp, NULL);
     ScrollSurface(bg_obj.buffer_lerp, 0, lerp(0, -bg_obj.bscroll));
-    SDL_BlitSurface(bg_obj.buffer_lerp, &towerbuffer_rect, backBuffer, NULL);
+    BlitSurfaceStandard(bg_obj.buffer_lerp, &towerbuffer_rect, backBuffer, NULL);
 }
 
 void Graphics::updatetowerbackground(TowerBG& bg_obj)
@@ -3157,6 +3882,18 @@ void Graphics::renderwithscreeneffects(void)
         flashlight();
     }
 
+    if (DRAWLIST_submit())
+    {
+        framepending = true;
+        pendingshake = game.screenshake > 0 && !game.noflashingmode;
+        pendingshake_x = screenshake_x;
+        pendingshake_y = screenshake_y;
+        pendingflipmode = flipmode;
+        SHMEXPORT_capture(&pendingexport);
+        return;
+    }
+    DRAWLIST_end();
+
     if (game.screenshake > 0 && !game.noflashingmode)
     {
         screenshake();
@@ -3167,6 +3904,33 @@ void Graphics::renderwithscreeneffects(void)
     }
 }
 
+bool Graphics::uploadpendingframe(bool* drawnflipmode, ShmExportState* drawnexport)
+{
+    if (!framepending)
+    {
+        return false;
+    }
+    framepending = false;
+
+    DRAWLIST_wait();
+
+    if (pendingshake)
+    {
+        SDL_Rect shakeRect = {pendingshake_x, pendingshake_y, backBuffer->w, backBuffer->h};
+        gameScreen.UpdateScreen(backBuffer, &shakeRect);
+
+        ClearSurface(backBuffer);
+    }
+    else
+    {
+        render();
+    }
+
+    *drawnflipmode = pendingflipmode;
+    *drawnexport = pendingexport;
+    return true;
+}
+
 void Graphics::renderfixedpre(void)
 {
     if (game.screenshake > 0)
@@ -3182,6 +3946,9 @@ void Graphics::renderfixedpre(void)
 
 void Graphics::renderfixedpost(void)
 {
+    /* The next fixed step can change anything */
+    basedrawn = false;
+
     /* Screen effects timers */
     if (game.flashlight > 0)
     {
@@ -3288,65 +4055,47 @@ void Graphics::setcolreal(Uint32 t)
     ct.colour = t;
 }
 
-void Graphics::drawforetile(int x, int y, int t)
+SDL_Surface* Graphics::getforetile(const int tileset, int t, const int off, const Uint32 onewaycol)
 {
-    if (!INBOUNDS_VEC(t, tiles))
+    switch (tileset)
     {
-        WHINE_ONCE("drawforetile() out-of-bounds!");
-        return;
-    }
-
-    SDL_Rect rect;
-    setRect(rect, x,y,tiles_rect.w, tiles_rect.h);
-
+    case 0:
+        if (!INBOUNDS_VEC(t, tiles))
+        {
+            WHINE_ONCE("getforetile() out-of-bounds!");
+            return NULL;
+        }
 #if !defined(NO_CUSTOM_LEVELS)
-    if (shouldrecoloroneway(t, tiles1_mounted))
-    {
-        colourTransform thect = {cl.getonewaycol()};
-        BlitSurfaceTinted(tiles[t], NULL, foregroundBuffer, &rect, thect);
-    }
-    else
+        if (shouldrecoloroneway(t, tiles1_mounted))
+        {
+            return get_tinted(tiles[t], onewaycol);
+        }
 #endif
-    {
-        BlitSurfaceStandard(tiles[t],NULL, foregroundBuffer, &rect  );
-    }
-}
-
-void Graphics::drawforetile2(int x, int y, int t)
-{
-    if (!INBOUNDS_VEC(t, tiles2))
-    {
-        WHINE_ONCE("drawforetile2() out-of-bounds!");
-        return;
-    }
-
-    SDL_Rect rect;
-    setRect(rect, x,y,tiles_rect.w, tiles_rect.h);
-
+        return tiles[t];
+    case 1:
+        if (!INBOUNDS_VEC(t, tiles2))
+        {
+            WHINE_ONCE("getforetile() out-of-bounds!");
+            return NULL;
+        }
 #if !defined(NO_CUSTOM_LEVELS)
-    if (shouldrecoloroneway(t, tiles2_mounted))
-    {
-        colourTransform thect = {cl.getonewaycol()};
-        BlitSurfaceTinted(tiles2[t], NULL, foregroundBuffer, &rect, thect);
-    }
-    else
+        if (shouldrecoloroneway(t, tiles2_mounted))
+        {
+            return get_tinted(tiles2[t], onewaycol);
+        }
 #endif
-    {
-        BlitSurfaceStandard(tiles2[t],NULL, foregroundBuffer, &rect  );
+        return tiles2[t];
+    case 2:
+        t += off * 30;
+        if (!INBOUNDS_VEC(t, tiles3))
+        {
+            WHINE_ONCE("getforetile() out-of-bounds!");
+            return NULL;
+        }
+        return tiles3[t];
     }
-}
 
-void Graphics::drawforetile3(int x, int y, int t, int off)
-{
-    t += off * 30;
-    if (!INBOUNDS_VEC(t, tiles3))
-    {
-        WHINE_ONCE("drawforetile3() out-of-bounds!");
-        return;
-    }
-    SDL_Rect rect;
-    setRect(rect, x,y,tiles_rect.w, tiles_rect.h);
-    BlitSurfaceStandard(tiles3[t],NULL, foregroundBuffer, &rect  );
+    return NULL;
 }
 
 void Graphics::drawrect(int x, int y, int w, int h, int r, int g, int b)
@@ -3381,6 +4130,9 @@ bool Graphics::onscreen(int t)
 
 bool Graphics::reloadresources(void)
 {
+    /* Anything still being drawn could be using what's about to go */
+    DRAWLIST_wait();
+
     grphx.destroy();
     grphx.init();
 
@@ -3418,6 +4170,7 @@ bool Graphics::reloadresources(void)
     tiles2_mounted = FILESYSTEM_isAssetMounted("graphics/tiles2.png");
     minimap_mounted = FILESYSTEM_isAssetMounted("graphics/minimap.png");
 #endif
+    assets_loaded = FILESYSTEM_getAssetPath();
 
     return true;
 
@@ -5,9 +5,11 @@
 #include <string>
 #include <vector>
 
+#include "EngineLocal.h"
 #include "GraphicsResources.h"
 #include "GraphicsUtil.h"
 #include "Maths.h"
+#include "ShmExport.h"
 #include "Textbox.h"
 #include "TowerBG.h"
 
@@ -132,6 +134,22 @@ public:
 
     void do_print(int x, int y, const std::string& text, int r, int g, int b, int a, int scale);
 
+    SDL_Surface* get_text_run(const std::string& text, int scale);
+
+    void clear_text_runs(void);
+
+    SDL_Surface* get_tinted(SDL_Surface* surface, Uint32 colour);
+
+    void clear_tinted(void);
+
+    SDL_Surface* get_scaled(SDL_Surface* surface, int scale);
+
+    void clear_scaled(void);
+
+    SDL_Surface* get_tower_strip(int colstate, int which, int index);
+
+    void clear_tower_strips(void);
+
     void Print(int _x, int _y, const std::string& _s, int r, int g, int b, bool cen = false);
 
     void PrintAlpha(int _x, int _y, const std::string& _s, int r, int g, int b, int a, bool cen = false);
@@ -159,8 +177,29 @@ public:
     int screenshake_x;
     int screenshake_y;
 
+    /* With a pipelined draw list, renderwithscreeneffects() leaves the frame
+     * drawing on another thread and uploadpendingframe() puts it on the
+     * screen at the start of the next render, with the screen effects it had
+     * when it was drawn */
+    bool framepending;
+    bool pendingshake;
+    int pendingshake_x;
+    int pendingshake_y;
+    bool pendingflipmode;
+    ShmExportState pendingexport;
+
+    /* Used by UpdateFilter() and ApplyFilter() */
+    int oldfilterscroll;
+    int filterscroll;
+    bool filterscrolling;
+
     void render(void);
     void renderwithscreeneffects(void);
+    /* Returns false if there was no frame pending. Doesn't flip, so that if
+     * the next render draws straight away, only its frame gets flipped;
+     * drawnflipmode and drawnexport are what to flip and export the pending
+     * one with otherwise. */
+    bool uploadpendingframe(bool* drawnflipmode, ShmExportState* drawnexport);
     void renderfixedpre(void);
     void renderfixedpost(void);
 
@@ -202,11 +241,13 @@ public:
 
     void drawmap(void);
 
-    void drawforetile(int x, int y, int t);
+    SDL_Surface* getforetile(int tileset, int t, int off, Uint32 onewaycol);
+
+    void drawforeground(bool final);
 
-    void drawforetile2(int x, int y, int t);
+    void prerenderneighbours(void);
 
-    void drawforetile3(int x, int y, int t, int off);
+    void clear_room_foregrounds(void);
 
     void drawrect(int x, int y, int w, int h, int r, int g, int b);
 
@@ -222,6 +263,8 @@ public:
     bool tiles2_mounted;
     bool minimap_mounted;
 #endif
+    /* FILESYSTEM_getAssetPath() as of the last reloadresources() */
+    std::string assets_loaded;
 
 
     void menuoffrender(void);
@@ -260,6 +303,7 @@ public:
     SDL_Surface* menubuffer;
     SDL_Surface* foregroundBuffer;
     SDL_Surface* tempBuffer;
+    SDL_Surface* baseBuffer;
     SDL_Surface* warpbuffer;
     SDL_Surface* warpbuffer_lerp;
 
@@ -279,6 +323,9 @@ public:
     int linestate, linedelay;
     int backoffset;
     bool backgrounddrawn, foregrounddrawn;
+    /* baseBuffer holds this fixed step's background and map, so frames
+     * rendered in between steps don't have to draw them again */
+    bool basedrawn;
 
     int menuoffset;
     int oldmenuoffset;
@@ -319,7 +366,105 @@ public:
 
     bool translucentroomname;
 
-    std::map<int, int> font_positions;
+    /* Glyph index of every codepoint, from graphics/font.txt. Two levels:
+     * font_page_index picks a page of 256 entries in font_pages, and every
+     * page without glyphs shares page 0. Codepoints that aren't in font.txt
+     * already point at the '?' glyph, or -1 if there isn't one.
+     * Both are empty if there's no font.txt. */
+    std::vector<Uint16> font_page_index;
+    std::vector<int> font_pages;
+
+    /* Strings already rendered by do_print(), so text that's drawn every
+     * frame only costs one blit per pass. They're kept in white and coloured
+     * as they're blitted, so glowing and fading text still hits the cache.
+     * Least recently used runs get evicted once there are too many or they
+     * take up too much memory. */
+    struct TextRunKey
+    {
+        std::string text;
+        int scale;
+        bool flipped;
+
+        bool operator<(const TextRunKey& other) const
+        {
+            if (scale != other.scale)
+            {
+                return scale < other.scale;
+            }
+            if (flipped != other.flipped)
+            {
+                return flipped < other.flipped;
+            }
+            return text < other.text;
+        }
+    };
+    struct TextRun
+    {
+        SDL_Surface* surface;
+        Uint32 last_used;
+    };
+    std::map<TextRunKey, TextRun> text_runs;
+    size_t text_run_bytes;
+    Uint32 text_run_clock;
+
+    /* Tinted copies of tiles, keyed by the tile surface and tint colour,
+     * so recoloured tiles are tinted once instead of on every draw */
+    std::map<std::pair<SDL_Surface*, Uint32>, SDL_Surface*> tinted_surfaces;
+
+    /* Bumped by clear_tinted(), so anything holding on to tinted surfaces
+     * can tell they've gone */
+    int tinted_generation;
+
+    /* Upscaled copies of sprites, keyed by the sprite surface (so the frame
+     * and flip mode) and scale */
+    std::map<std::pair<SDL_Surface*, int>, SDL_Surface*> scaled_surfaces;
+
+    /* Tower tiles prerendered a few rows at a time, so scrolling through the
+     * tower blits a handful of strips instead of every tile. Keyed by colour
+     * state, which tiles (main tower, minitower or spikes) and strip index.
+     * Strips that haven't been drawn in a while are evicted, and they're all
+     * thrown away whenever map.tower's version changes. */
+    struct TowerStripKey
+    {
+        int colstate;
+        int which;
+        int index;
+
+        bool operator<(const TowerStripKey& other) const
+        {
+            if (colstate != other.colstate)
+            {
+                return colstate < other.colstate;
+            }
+            if (which != other.which)
+            {
+                return which < other.which;
+            }
+            return index < other.index;
+        }
+    };
+    struct TowerStrip
+    {
+        SDL_Surface* surface;
+        Uint32 last_used;
+    };
+    std::map<TowerStripKey, TowerStrip> tower_strips;
+    Uint32 tower_strip_clock;
+    int tower_strips_version;
+
+    /* Room foregrounds that have already been drawn, either when the room
+     * was last visited or ahead of time by the prerender thread. Keyed by a
+     * hash of the tile surface in every cell, which captures everything that
+     * decides what the foreground looks like. */
+    struct RoomForeground
+    {
+        std::vector<SDL_Surface*> cells;
+        SDL_Surface* surface;
+        Uint32 last_used;
+    };
+    std::map<Uint64, RoomForeground> room_foregrounds;
+    Uint32 room_foreground_clock;
+    std::vector<SDL_Surface*> foreground_cells;
 
     SDL_Surface* ghostbuffer;
 
@@ -352,7 +497,7 @@ public:
 };
 
 #ifndef GRAPHICS_DEFINITION
-extern Graphics graphics;
+extern ENGINE_LOCAL Graphics& graphics;
 #endif
 
 #endif /* GRAPHICS_H */
@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdlib.h>
 
+#include "Blit.h"
+#include "DrawList.h"
 #include "Graphics.h"
 #include "Maths.h"
 
@@ -171,6 +173,56 @@ SDL_Surface * ScaleSurface( SDL_Surface *_surface, int Width, int Height, SDL_Su
     return _ret;
 }
 
+SDL_Surface* ScaleSurfaceInteger(SDL_Surface* _src, const int factor)
+{
+    SDL_Surface* ret;
+
+    if (_src == NULL || factor < 1)
+    {
+        return NULL;
+    }
+
+    if (_src->format->BytesPerPixel != 4)
+    {
+        return ScaleSurface(_src, _src->w * factor, _src->h * factor);
+    }
+
+    ret = RecreateSurfaceWithDimensions(_src, _src->w * factor, _src->h * factor);
+    if (ret == NULL)
+    {
+        return NULL;
+    }
+
+    SDL_LockSurface(_src);
+    SDL_LockSurface(ret);
+
+    for (int y = 0; y < _src->h; y++)
+    {
+        const Uint32* src_row = (const Uint32*) ((const Uint8*) _src->pixels + y * _src->pitch);
+        Uint8* first_row = (Uint8*) ret->pixels + y * factor * ret->pitch;
+        Uint32* dest_row = (Uint32*) first_row;
+
+        /* Widen one row, then copy it down for the rest of the block */
+        for (int x = 0; x < _src->w; x++)
+        {
+            const Uint32 pixel = src_row[x];
+            for (int i = 0; i < factor; i++)
+            {
+                *dest_row++ = pixel;
+            }
+        }
+        for (int i = 1; i < factor; i++)
+        {
+            SDL_memcpy(first_row + i * ret->pitch, first_row, ret->w * 4);
+        }
+    }
+
+    SDL_UnlockSurface(ret);
+    SDL_UnlockSurface(_src);
+
+    return ret;
+}
+
 SDL_Surface *  FlipSurfaceVerticle(SDL_Surface* _src)
 {
     SDL_Surface * ret = RecreateSurface(_src);
@@ -194,9 +246,48 @@ SDL_Surface *  FlipSurfaceVerticle(SDL_Surface* _src)
 
 void BlitSurfaceStandard( SDL_Surface* _src, SDL_Rect* _srcRect, SDL_Surface* _dest, SDL_Rect* _destRect )
 {
+    if (DRAWLIST_blit(_src, _srcRect, _dest, _destRect))
+    {
+        return;
+    }
+    DRAWLIST_sync(_src);
+    DRAWLIST_sync(_dest);
+    if (BlitFast(_src, _srcRect, _dest, _destRect))
+    {
+        return;
+    }
     SDL_BlitSurface( _src, _srcRect, _dest, _destRect );
 }
 
+void BlitSurfaceRow(
+    SDL_Surface* const* row,
+    const int count,
+    const int step,
+    SDL_Surface* _dest,
+    const int x,
+    const int y
+) {
+    if (DRAWLIST_blitRow(row, count, step, _dest, x, y))
+    {
+        return;
+    }
+    /* The tiles only ever get read, so only the destination needs syncing */
+    DRAWLIST_sync(_dest);
+    if (BlitRow(row, count, step, _dest, x, y))
+    {
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (row[i] != NULL)
+        {
+            SDL_Rect rect = {x + i * step, y, 0, 0};
+            BlitSurfaceStandard(row[i], NULL, _dest, &rect);
+        }
+    }
+}
+
 void BlitSurfaceColoured(
     SDL_Surface* _src,
     SDL_Rect* _srcRect,
@@ -204,9 +295,18 @@ void BlitSurfaceColoured(
     SDL_Rect* _destRect,
     colourTransform& ct
 ) {
-    SDL_Rect *tempRect = _destRect;
+    if (DRAWLIST_blitColoured(_src, _srcRect, _dest, _destRect, ct.colour))
+    {
+        return;
+    }
+    DRAWLIST_sync(_src);
+    DRAWLIST_sync(_dest);
+    if (BlitFastColoured(_src, _srcRect, _dest, _destRect, ct.colour))
+    {
+        return;
+    }
 
-    const SDL_PixelFormat& fmt = *(_src->format);
+    SDL_Rect *tempRect = _destRect;
 
     SDL_Surface* tempsurface =  RecreateSurface(_src);
 
@@ -215,13 +315,7 @@ void BlitSurfaceColoured(
         for(int y = 0; y < tempsurface->h; y++)
         {
             Uint32 pixel = ReadPixel(_src, x, y);
-            Uint32 Alpha = pixel & fmt.Amask;
-            Uint32 result = ct.colour & 0x00FFFFFF;
-            Uint32 CTAlpha = ct.colour & fmt.Amask;
-            float div1 = ((Alpha >> 24) / 255.0f);
-            float div2 = ((CTAlpha >> 24) / 255.0f);
-            Uint32 UseAlpha = (div1 * div2) * 255.0f;
-            DrawPixel(tempsurface, x, y, result | (UseAlpha << 24));
+            DrawPixel(tempsurface, x, y, BlitColourPixel(pixel, ct.colour));
         }
     }
 
@@ -229,18 +323,42 @@ void BlitSurfaceColoured(
     SDL_FreeSurface(tempsurface);
 }
 
-void BlitSurfaceTinted(
+void DrawSurfaceColoured(
     SDL_Surface* _src,
-    SDL_Rect* _srcRect,
     SDL_Surface* _dest,
-    SDL_Rect* _destRect,
+    const int _x,
+    const int _y,
     colourTransform& ct
 ) {
-    SDL_Rect *tempRect = _destRect;
+    DRAWLIST_sync(_dest);
+
+    for (int x = 0; x < _src->w; x++)
+    {
+        if (_x + x < 0 || _x + x >= _dest->w)
+        {
+            continue;
+        }
+        for (int y = 0; y < _src->h; y++)
+        {
+            if (_y + y < 0 || _y + y >= _dest->h)
+            {
+                continue;
+            }
+            Uint32 pixel = ReadPixel(_src, x, y);
+            DrawPixel(_dest, _x + x, _y + y, BlitColourPixel(pixel, ct.colour));
+        }
+    }
+}
 
+SDL_Surface* TintSurface(SDL_Surface* _src, colourTransform& ct)
+{
     const SDL_PixelFormat& fmt = *(_src->format);
 
     SDL_Surface* tempsurface =  RecreateSurface(_src);
+    if (tempsurface == NULL)
+    {
+        return NULL;
+    }
 
     for (int x = 0; x < tempsurface->w; x++) {
         for (int y = 0; y < tempsurface->h; y++) {
@@ -286,31 +404,40 @@ void BlitSurfaceTinted(
         }
     }
 
-    SDL_BlitSurface(tempsurface, _srcRect, _dest, tempRect);
-    SDL_FreeSurface(tempsurface);
+    return tempsurface;
 }
 
+void BlitSurfaceTinted(
+    SDL_Surface* _src,
+    SDL_Rect* _srcRect,
+    SDL_Surface* _dest,
+    SDL_Rect* _destRect,
+    colourTransform& ct
+) {
+    SDL_Surface* tempsurface = TintSurface(_src, ct);
+
+    DRAWLIST_sync(_dest);
+    SDL_BlitSurface(tempsurface, _srcRect, _dest, _destRect);
+    SDL_FreeSurface(tempsurface);
+}
 
-static int oldscrollamount = 0;
-static int scrollamount = 0;
-static bool isscrolling = 0;
 
 void UpdateFilter(void)
 {
     if (rand() % 4000 < 8)
     {
-        isscrolling = true;
+        graphics.filterscrolling = true;
     }
 
-    oldscrollamount = scrollamount;
-    if(isscrolling == true)
+    graphics.oldfilterscroll = graphics.filterscroll;
+    if(graphics.filterscrolling == true)
     {
-        scrollamount += 20;
-        if(scrollamount > 240)
+        graphics.filterscroll += 20;
+        if(graphics.filterscroll > 240)
         {
-            scrollamount = 0;
-            oldscrollamount = 0;
-            isscrolling = false;
+            graphics.filterscroll = 0;
+            graphics.oldfilterscroll = 0;
+            graphics.filterscrolling = false;
         }
     }
 }
@@ -325,7 +452,7 @@ SDL_Surface* ApplyFilter( SDL_Surface* _src )
     {
         for(int y = 0; y < _src->h; y++)
         {
-            int sampley = (y + (int) graphics.lerp(oldscrollamount, scrollamount) )% 240;
+            int sampley = (y + (int) graphics.lerp(graphics.oldfilterscroll, graphics.filterscroll) )% 240;
 
             Uint32 pixel = ReadPixel(_src, x,sampley);
 
@@ -337,7 +464,7 @@ SDL_Surface* ApplyFilter( SDL_Surface* _src )
 
             double mult;
             int tmp; /* needed to avoid char overflow */
-            if(isscrolling && sampley > 220 && ((rand() %10) < 4))
+            if(graphics.filterscrolling && sampley > 220 && ((rand() %10) < 4))
             {
                 mult = 0.6;
             }
@@ -375,44 +502,54 @@ SDL_Surface* ApplyFilter( SDL_Surface* _src )
     return _ret;
 }
 
+static void fill_rect(SDL_Surface* surface, const SDL_Rect* rect, const Uint32 colour)
+{
+    if (DRAWLIST_fill(surface, rect, colour))
+    {
+        return;
+    }
+    DRAWLIST_sync(surface);
+    SDL_FillRect(surface, rect, colour);
+}
+
 void FillRect( SDL_Surface* _surface, const int _x, const int _y, const int _w, const int _h, const int r, int g, int b )
 {
     SDL_Rect rect = {_x, _y, _w, _h};
     Uint32 color = SDL_MapRGB(_surface->format, r, g, b);
-    SDL_FillRect(_surface, &rect, color);
+    fill_rect(_surface, &rect, color);
 }
 
 void FillRect( SDL_Surface* _surface, const int r, int g, int b )
 {
     Uint32 color = SDL_MapRGB(_surface->format, r, g, b);
-    SDL_FillRect(_surface, NULL, color);
+    fill_rect(_surface, NULL, color);
 }
 
 void FillRect( SDL_Surface* _surface, const int color )
 {
-    SDL_FillRect(_surface, NULL, color);
+    fill_rect(_surface, NULL, color);
 }
 
 void FillRect( SDL_Surface* _surface, const int x, const int y, const int w, const int h, int rgba )
 {
     SDL_Rect rect = {x, y, w, h};
-    SDL_FillRect(_surface, &rect, rgba);
+    fill_rect(_surface, &rect, rgba);
 }
 
 void FillRect( SDL_Surface* _surface, SDL_Rect& _rect, const int r, int g, int b )
 {
     Uint32 color = SDL_MapRGB(_surface->format, r, g, b);
-    SDL_FillRect(_surface, &_rect, color);
+    fill_rect(_surface, &_rect, color);
 }
 
 void FillRect( SDL_Surface* _surface, SDL_Rect rect, int rgba )
 {
-    SDL_FillRect(_surface, &rect, rgba);
+    fill_rect(_surface, &rect, rgba);
 }
 
 void ClearSurface(SDL_Surface* surface)
 {
-    SDL_FillRect(surface, NULL, 0x00000000);
+    fill_rect(surface, NULL, 0x00000000);
 }
 
 void ScrollSurface( SDL_Surface* _src, int _pX, int _pY )
@@ -421,6 +558,9 @@ void ScrollSurface( SDL_Surface* _src, int _pX, int _pY )
 
     SDL_Rect rect1;
     SDL_Rect rect2;
+
+    DRAWLIST_sync(_src);
+
     //scrolling up;
     if(_pY < 0)
     {
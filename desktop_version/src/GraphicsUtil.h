@@ -17,10 +17,24 @@ Uint32 ReadPixel( SDL_Surface *surface, int x, int y );
 
 SDL_Surface * ScaleSurface( SDL_Surface *Surface, int Width, int Height, SDL_Surface * Dest = NULL );
 
+/* Nearest-neighbour upscale by a whole number, copying pixels as-is */
+SDL_Surface* ScaleSurfaceInteger( SDL_Surface* _src, int factor );
+
 void BlitSurfaceStandard( SDL_Surface* _src, SDL_Rect* _srcRect, SDL_Surface* _dest, SDL_Rect* _destRect );
 
 void BlitSurfaceColoured( SDL_Surface* _src, SDL_Rect* _srcRect, SDL_Surface* _dest, SDL_Rect* _destRect, colourTransform& ct );
 
+/* BlitSurfaceStandard() for a row of tiles, as laid out for BlitRow() */
+void BlitSurfaceRow( SDL_Surface* const* row, int count, int step, SDL_Surface* _dest, int x, int y );
+
+/* Colours _src like BlitSurfaceColoured(), but replaces the pixels at (x, y)
+ * in _dest instead of blending onto them */
+void DrawSurfaceColoured( SDL_Surface* _src, SDL_Surface* _dest, int x, int y, colourTransform& ct );
+
+/* Returns a new surface with _src's luminance tinted by ct, as drawn by
+ * BlitSurfaceTinted() */
+SDL_Surface* TintSurface( SDL_Surface* _src, colourTransform& ct );
+
 void BlitSurfaceTinted( SDL_Surface* _src, SDL_Rect* _srcRect, SDL_Surface* _dest, SDL_Rect* _destRect, colourTransform& ct );
 
 void FillRect( SDL_Surface* surface, const int x, const int y, const int w, const int h, const int r, int g, int b );
@@ -277,9 +277,9 @@ static void toggleflipmode(void)
     }
 }
 
-static bool fadetomode = false;
-static int fadetomodedelay = 0;
-static int gotomode = 0;
+static ENGINE_LOCAL bool fadetomode = false;
+static ENGINE_LOCAL int fadetomodedelay = 0;
+static ENGINE_LOCAL int gotomode = 0;
 
 static void startmode(const int mode)
 {
@@ -309,8 +309,8 @@ static void handlefadetomode(void)
     }
 }
 
-static int* user_changing_volume = NULL;
-static int previous_volume = 0;
+static ENGINE_LOCAL int* user_changing_volume = NULL;
+static ENGINE_LOCAL int previous_volume = 0;
 
 static void initvolumeslider(const int menuoption)
 {
@@ -131,7 +131,7 @@ static int changemousestate(
 
 void KeyPoll::Poll(void)
 {
-    static int mousetoggletimeout = 0;
+    static ENGINE_LOCAL int mousetoggletimeout = 0;
     bool showmouse = false;
     bool hidemouse = false;
     bool altpressed = false;
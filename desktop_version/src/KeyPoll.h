@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "EngineLocal.h"
+
 enum Kybrd
 {
     KEYBOARD_UP = SDLK_UP,
@@ -77,7 +79,7 @@ private:
 };
 
 #ifndef KEY_DEFINITION
-extern KeyPoll key;
+extern ENGINE_LOCAL KeyPoll& key;
 #endif
 
 #endif /* KEYPOLL_H */
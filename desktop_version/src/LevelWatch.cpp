@@ -0,0 +1,363 @@
+#include "LevelWatch.h"
+
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+#include "CustomLevels.h"
+#include "Enums.h"
+#include "FileSystemUtils.h"
+#include "Game.h"
+#include "Graphics.h"
+#include "Map.h"
+#include "Music.h"
+#include "Script.h"
+#include "Vlogging.h"
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_INOTIFY
+#endif
+
+#ifdef HAVE_INOTIFY
+
+/* Editors often write a file in a few goes, or write a new one and move it
+ * over the old one, so wait for things to settle before reloading */
+#define SETTLE_TICKS 100
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+struct Watch
+{
+    int wd;
+    bool assets;
+    /* Only changes to this file in the directory count, or any if empty */
+    std::string name;
+};
+
+static int inotify_fd = -1;
+static std::vector<Watch> watches;
+/* Level file name, as for cl.load(), or empty if nothing's being played */
+static std::string watched_level;
+static std::string watched_assets;
+static bool level_changed = false;
+static bool assets_changed = false;
+static Uint32 last_change = 0;
+
+bool LEVELWATCH_init(void)
+{
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd == -1)
+    {
+        vlog_error("Could not start watching for level changes: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void unwatch(void)
+{
+    for (size_t i = 0; i < watches.size(); i++)
+    {
+        /* Watching the same directory twice gives the same descriptor, so
+         * this can fail for the second one, which is fine */
+        inotify_rm_watch(inotify_fd, watches[i].wd);
+    }
+    watches.clear();
+    watched_level.clear();
+    watched_assets.clear();
+    level_changed = false;
+    assets_changed = false;
+}
+
+void LEVELWATCH_quit(void)
+{
+    if (inotify_fd != -1)
+    {
+        unwatch();
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+}
+
+static void add_watch(const std::string& path, const bool assets, const std::string& name)
+{
+    Watch watch;
+
+    watch.wd = inotify_add_watch(inotify_fd, path.c_str(), WATCH_MASK);
+    if (watch.wd == -1)
+    {
+        vlog_debug("Not watching %s: %s", path.c_str(), strerror(errno));
+        return;
+    }
+    watch.assets = assets;
+    watch.name = name;
+    watches.push_back(watch);
+}
+
+/* Watches the directory path is in, for changes to path itself */
+static void add_file_watch(const std::string& path, const bool assets)
+{
+    const size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos)
+    {
+        return;
+    }
+    add_watch(path.substr(0, slash), assets, path.substr(slash + 1));
+}
+
+static bool is_directory(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static void watch_assets(const std::string& path)
+{
+    if (!is_directory(path))
+    {
+        /* A zip */
+        add_file_watch(path, true);
+        return;
+    }
+
+    /* graphics/, sounds/ and so on. Folders made after this aren't
+     * noticed until the level is played again. */
+    add_watch(path, true, "");
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+    {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        const std::string child = path + "/" + entry->d_name;
+        if (is_directory(child))
+        {
+            add_watch(child, true, "");
+        }
+    }
+    closedir(dir);
+}
+
+static void watch(const std::string& level, const std::string& assets)
+{
+    unwatch();
+    watched_level = level;
+    watched_assets = assets;
+
+    if (!level.empty())
+    {
+        /* A level in a zip can't be edited in place, so this just never
+         * sees anything for those */
+        add_file_watch(
+            std::string(FILESYSTEM_getUserLevelDirectory()) + level.substr(SDL_strlen("levels/")),
+            false
+        );
+        vlog_debug("Watching %s for changes", level.c_str());
+    }
+    if (!assets.empty())
+    {
+        watch_assets(assets);
+    }
+}
+
+static void read_events(void)
+{
+    /* Aligned for inotify_event */
+    Uint64 buffer[512];
+
+    while (true)
+    {
+        const ssize_t got = read(inotify_fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+
+        const char* bytes = (const char*) buffer;
+        ssize_t offset = 0;
+        while (offset < got)
+        {
+            const struct inotify_event* event = (const struct inotify_event*) &bytes[offset];
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                level_changed = !watched_level.empty();
+                assets_changed = !watched_assets.empty();
+                last_change = SDL_GetTicks();
+                continue;
+            }
+
+            for (size_t i = 0; i < watches.size(); i++)
+            {
+                if (watches[i].wd != event->wd
+                || (!watches[i].name.empty()
+                && (event->len == 0 || watches[i].name != event->name)))
+                {
+                    continue;
+                }
+
+                if (watches[i].assets)
+                {
+                    assets_changed = true;
+                }
+                else
+                {
+                    level_changed = true;
+                }
+                last_change = SDL_GetTicks();
+            }
+        }
+    }
+}
+
+/* Starts the song that was playing before the assets were reloaded */
+static void restart_music(int song)
+{
+    if (song == -1)
+    {
+        return;
+    }
+    /* Undo what play() does to the number */
+    if (music.mmmmmm && !music.usingmmmmmm)
+    {
+        song -= music.num_mmmmmm_tracks;
+    }
+    music.currentsong = -1;
+    music.play(song);
+}
+
+static void reload_level(void)
+{
+    const int changed = cl.reload(watched_level);
+    const int room_sections = (1 << LevelSection_map)
+        | (1 << LevelSection_contents)
+        | (1 << LevelSection_entities)
+        | (1 << LevelSection_rooms);
+
+    if (changed == -1)
+    {
+        /* Caught it halfway through being saved, most likely. Keep playing
+         * what we have until the next change. */
+        return;
+    }
+    if (changed == 0)
+    {
+        vlog_debug("%s changed, but not anything the game uses", watched_level.c_str());
+        return;
+    }
+    vlog_info("Reloaded %s", watched_level.c_str());
+
+    if (changed & (1 << LevelSection_metadata))
+    {
+        game.customleveltitle = cl.title;
+    }
+
+    if (changed & room_sections)
+    {
+        /* Brings the room's entities back too, except the player */
+        map.gotoroom(game.roomx, game.roomy);
+        graphics.backgrounddrawn = false;
+    }
+
+    if (changed & ((1 << LevelSection_map) | (1 << LevelSection_contents)))
+    {
+        cl.generatecustomminimap();
+    }
+}
+
+void LEVELWATCH_update(void)
+{
+    std::string level;
+    std::string assets;
+
+    if (inotify_fd == -1)
+    {
+        return;
+    }
+
+    if (map.custommodeforreal
+    && (game.gamestate == GAMEMODE
+    || game.gamestate == MAPMODE
+    || game.gamestate == TELEPORTERMODE))
+    {
+        level = game.customlevelfilename;
+        if (level.compare(0, SDL_strlen("levels/"), "levels/") != 0)
+        {
+            level = "levels/" + level;
+        }
+        assets = FILESYSTEM_getAssetPath();
+    }
+    if (level != watched_level || assets != watched_assets)
+    {
+        watch(level, assets);
+    }
+
+    read_events();
+
+    if ((!level_changed && !assets_changed)
+    || SDL_GetTicks() - last_change < SETTLE_TICKS
+    /* Don't pull the room out from under a cutscene or a death */
+    || game.gamestate != GAMEMODE
+    || script.running
+    || game.deathseq != -1)
+    {
+        return;
+    }
+
+    if (assets_changed)
+    {
+        const int song = music.currentsong;
+
+        assets_changed = false;
+        vlog_info("Reloading assets from %s", watched_assets.c_str());
+        if (!FILESYSTEM_reloadAssets())
+        {
+            vlog_error("Could not reload assets from %s", watched_assets.c_str());
+        }
+        restart_music(song);
+        graphics.backgrounddrawn = false;
+        graphics.foregrounddrawn = false;
+    }
+
+    if (level_changed)
+    {
+        level_changed = false;
+        reload_level();
+    }
+}
+
+#else /* HAVE_INOTIFY */
+
+bool LEVELWATCH_init(void)
+{
+    vlog_error("Watching levels for changes isn't supported on this platform.");
+    return false;
+}
+
+void LEVELWATCH_quit(void)
+{
+}
+
+void LEVELWATCH_update(void)
+{
+}
+
+#endif /* HAVE_INOTIFY */
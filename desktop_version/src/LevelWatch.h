@@ -0,0 +1,16 @@
+#ifndef LEVELWATCH_H
+#define LEVELWATCH_H
+
+/* Watches the custom level being played, and its assets, for changes on
+ * disk, and puts them into the running game: changed parts of the level file
+ * are read again and the current room is reloaded in place, with the player
+ * left where they are, and changed assets are reloaded. Only on Linux, with
+ * inotify. */
+bool LEVELWATCH_init(void);
+
+void LEVELWATCH_quit(void);
+
+/* Call once per frame */
+void LEVELWATCH_update(void);
+
+#endif /* LEVELWATCH_H */
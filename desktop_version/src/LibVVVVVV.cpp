@@ -0,0 +1,712 @@
+#include "LibVVVVVV.h"
+
+#include <SDL.h>
+#include <map>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "CustomLevels.h"
+#include "Engine.h"
+#include "Entity.h"
+#include "Enums.h"
+#include "Exit.h"
+#include "FileSystemUtils.h"
+#include "Game.h"
+#include "Graphics.h"
+#include "KeyPoll.h"
+#include "Map.h"
+#include "Music.h"
+#include "Screen.h"
+#include "Script.h"
+#include "UtilityClass.h"
+#include "Vlogging.h"
+#include "Xoshiro.h"
+
+/* The parts of Graphics the fixed frames change that matter to the game.
+ * Everything else in there is either a resource or redrawn every frame. */
+struct GraphicsState
+{
+    bool flipmode;
+    int fademode;
+    int fadeamount;
+    int oldfadeamount;
+    int fadebars[SDL_arraysize(graphics.fadebars)];
+    int ingame_fademode;
+    std::vector<textboxclass> textboxes;
+    bool showcutscenebars;
+    int cutscenebarspos;
+    int oldcutscenebarspos;
+    int screenshake_x;
+    int screenshake_y;
+    int crewframe;
+    int crewframedelay;
+    bool trinketcolset;
+    int trinketr, trinketg, trinketb;
+    int rcol;
+    int linestate, linedelay;
+    int backoffset;
+    int menuoffset;
+    int oldmenuoffset;
+    bool resumegamemode;
+    int towerbg_bypos, towerbg_bscroll, towerbg_colstate, towerbg_scrolldir;
+};
+
+struct Snapshot
+{
+    Game game;
+    mapclass map;
+    entityclass obj;
+    scriptclass script;
+    UtilityClass help;
+    GraphicsState graphics;
+
+    const struct ImplFunc* gamestate_funcs;
+    int num_gamestate_funcs;
+    int gamestate_func_index;
+
+    Uint32 xoshiro[4];
+    Uint32 frandom[4];
+    int frames;
+};
+
+/* One instance per thread, like the engine itself (see EngineLocal.h) */
+static ENGINE_LOCAL bool created = false;
+static ENGINE_LOCAL bool running = false;
+
+static ENGINE_LOCAL std::string level;
+static ENGINE_LOCAL int mode = 0;
+static ENGINE_LOCAL unsigned int seed = 0;
+
+static ENGINE_LOCAL int frames = 0;
+
+static ENGINE_LOCAL std::map<int, Snapshot> snapshots;
+static ENGINE_LOCAL int next_snapshot = 0;
+
+/* Set up once for every instance in the process, under
+ * ENGINE_lock_process() */
+static int instances = 0;
+static std::string basedir;
+static std::string assets;
+
+static bool init_process(const std::string& new_basedir, const std::string& new_assets)
+{
+    if (instances > 0)
+    {
+        /* PhysFS only has the one search path */
+        if (new_basedir != basedir || new_assets != assets)
+        {
+            vlog_error("Every libvvvvvv instance in a process needs the same basedir and assets.");
+            return false;
+        }
+        instances++;
+        return true;
+    }
+
+    basedir = new_basedir;
+    assets = new_assets;
+
+    /* Nothing gets shown or heard */
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+    vlog_init();
+
+    if (!FILESYSTEM_init(
+        NULL,
+        basedir.empty() ? NULL : &basedir[0],
+        assets.empty() ? NULL : &assets[0]
+    )) {
+        vlog_error("Unable to initialize filesystem!");
+        return false;
+    }
+
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+    instances++;
+    return true;
+}
+
+static void quit_process(void)
+{
+    if (--instances > 0)
+    {
+        return;
+    }
+
+    SDL_Quit();
+    FILESYSTEM_deinit();
+}
+
+static void teardown(void)
+{
+    /* Same order as cleanup() in main.cpp, minus saving anything: nobody
+     * wants a training run writing over their settings */
+    if (!running)
+    {
+        return;
+    }
+    running = false;
+
+    const EngineProcessLock lock;
+
+    snapshots.clear();
+    gameScreen.destroy();
+    graphics.grphx.destroy();
+    graphics.destroy_buffers();
+    graphics.destroy();
+    if (instances > 1)
+    {
+        /* The other instances are still using the sound cache */
+        music.destroy();
+    }
+    else
+    {
+        music.deinit();
+    }
+    quit_process();
+}
+
+SDL_NORETURN void VVV_exit(const int exit_code)
+{
+    teardown();
+    exit(exit_code);
+}
+
+static void set_buttons(const unsigned int buttons)
+{
+    key.keymap[KEYBOARD_LEFT] = (buttons & VVVVVV_BUTTON_LEFT) != 0;
+    key.keymap[KEYBOARD_RIGHT] = (buttons & VVVVVV_BUTTON_RIGHT) != 0;
+    key.keymap[KEYBOARD_UP] = (buttons & VVVVVV_BUTTON_UP) != 0;
+    key.keymap[KEYBOARD_DOWN] = (buttons & VVVVVV_BUTTON_DOWN) != 0;
+    key.keymap[KEYBOARD_SPACE] = (buttons & VVVVVV_BUTTON_ACTION) != 0;
+    key.keymap[KEYBOARD_ENTER] = (buttons & VVVVVV_BUTTON_MAP) != 0;
+    key.keymap[SDLK_ESCAPE] = (buttons & VVVVVV_BUTTON_ESCAPE) != 0;
+    key.keymap[KEYBOARD_e] = (buttons & VVVVVV_BUTTON_INTERACT) != 0;
+    key.keymap[SDLK_r] = (buttons & VVVVVV_BUTTON_RESTART) != 0;
+}
+
+static bool start(void)
+{
+    srand(seed);
+    xoshiro_seed(seed);
+    xoshiro_fseed(seed);
+    set_buttons(0);
+
+#if !defined(NO_CUSTOM_LEVELS)
+    if (!level.empty())
+    {
+        const std::string filename = "levels/" + level + ".vvvvvv";
+
+        if (!ENGINE_start_playtest(filename, false))
+        {
+            vlog_error("Level not found: %s", filename.c_str());
+            return false;
+        }
+    }
+    else
+#endif
+    {
+        script.startgamemode(mode);
+    }
+
+    graphics.fademode = 0;
+
+    ENGINE_begin();
+    frames = 0;
+
+    return true;
+}
+
+int VVVVVV_create(const VVVVVV_Options* options)
+{
+    if (created)
+    {
+        vlog_error("libvvvvvv can only be created once per thread.");
+        return -1;
+    }
+    created = true;
+
+    level = options->level != NULL ? options->level : "";
+    mode = options->mode;
+    seed = options->seed;
+
+#if defined(NO_CUSTOM_LEVELS)
+    if (!level.empty())
+    {
+        vlog_error("This build doesn't support custom levels.");
+        return -1;
+    }
+#endif
+
+    /* Loading is all done one instance at a time; it's the stepping that
+     * runs side by side */
+    const EngineProcessLock lock;
+
+    if (!init_process(
+        options->basedir != NULL ? options->basedir : "",
+        options->assets != NULL ? options->assets : ""
+    )) {
+        return -1;
+    }
+    running = true;
+
+    /* No room prerendering or render threads: their queues are shared by
+     * the whole process, and they'd get an engine of their own */
+    graphics.init();
+
+    game.init();
+
+    if (!graphics.reloadresources())
+    {
+        vlog_error("%s: %s", graphics.error_title, graphics.error);
+        teardown();
+        return -1;
+    }
+
+    {
+        struct ScreenSettings screen_settings;
+        SDL_zero(screen_settings);
+        ScreenSettings_default(&screen_settings);
+        game.loadstats(&screen_settings);
+        game.loadsettings(&screen_settings);
+        gameScreen.init(&screen_settings);
+    }
+    gameScreen.keepframe = true;
+
+    graphics.create_buffers(gameScreen.GetFormat());
+
+    if (game.slowdown == 0)
+    {
+        game.slowdown = 30;
+    }
+
+    obj.init();
+
+    key.isActive = true;
+
+    if (!start())
+    {
+        teardown();
+        return -1;
+    }
+
+    return 0;
+}
+
+void VVVVVV_destroy(void)
+{
+    teardown();
+}
+
+int VVVVVV_reset(void)
+{
+    if (!running)
+    {
+        return -1;
+    }
+
+    return start() ? 0 : -1;
+}
+
+int VVVVVV_step(const int num_frames, const unsigned int buttons)
+{
+    if (!running)
+    {
+        return -1;
+    }
+
+    /* Nobody reads the events, so don't let them pile up */
+    {
+        const EngineProcessLock lock;
+        SDL_PumpEvents();
+        SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+    }
+
+    set_buttons(buttons);
+
+    for (int i = 0; i < num_frames; i++)
+    {
+        ENGINE_step();
+        frames++;
+    }
+
+    return 0;
+}
+
+const void* VVVVVV_render(int* width, int* height, int* pitch)
+{
+    if (!running)
+    {
+        return NULL;
+    }
+
+    const struct ImplFunc* implfunc = &engine.gamestate_funcs[engine.gamestate_func_index];
+    Uint32 frandom[4];
+
+    /* Drawing uses fRandom() too (e.g. the player's colour), and looking at
+     * a frame shouldn't change what happens next */
+    xoshiro_fget_state(frandom);
+
+    graphics.alpha = 1.0f;
+    if (implfunc->type == Func_delta && implfunc->func != NULL)
+    {
+        implfunc->func();
+    }
+
+    xoshiro_fset_state(frandom);
+
+    const SDL_Surface* frame = gameScreen.m_screen;
+    *width = frame->w;
+    *height = frame->h;
+    *pitch = frame->pitch;
+    return frame->pixels;
+}
+
+void VVVVVV_get_state(VVVVVV_State* state)
+{
+    const int player = obj.getplayer();
+
+    SDL_zerop(state);
+
+    state->gamestate = game.gamestate;
+    state->frames = frames;
+    state->room_x = game.roomx;
+    state->room_y = game.roomy;
+
+    if (INBOUNDS_VEC(player, obj.entities))
+    {
+        const entclass& entity = obj.entities[player];
+        state->has_player = 1;
+        state->player_x = entity.xp;
+        state->player_y = entity.yp;
+        state->player_vx = entity.vx;
+        state->player_vy = entity.vy;
+        state->player_flipped = game.gravitycontrol;
+        state->player_onground = entity.onground > 0 || entity.onroof > 0;
+        state->player_dying = game.deathseq != -1;
+    }
+
+    state->deaths = game.deathcounts;
+    state->trinkets = game.trinkets();
+    state->crewmates = game.crewmates();
+    state->num_entities = obj.entities.size();
+}
+
+int VVVVVV_get_entities(VVVVVV_Entity* entities, const int max)
+{
+    const int count = obj.entities.size();
+
+    for (int i = 0; i < count && i < max; i++)
+    {
+        const entclass& entity = obj.entities[i];
+        VVVVVV_Entity* out = &entities[i];
+
+        out->type = entity.type;
+        out->rule = entity.rule;
+        out->state = entity.state;
+        out->behave = entity.behave;
+        out->x = entity.xp;
+        out->y = entity.yp;
+        out->cx = entity.cx;
+        out->cy = entity.cy;
+        out->w = entity.w;
+        out->h = entity.h;
+        out->vx = entity.vx;
+        out->vy = entity.vy;
+        out->harmful = entity.harmful;
+        out->invis = entity.invis;
+    }
+
+    return count;
+}
+
+int VVVVVV_get_flags(unsigned char* flags, const int max)
+{
+    const int count = SDL_arraysize(obj.flags);
+
+    for (int i = 0; i < count && i < max; i++)
+    {
+        flags[i] = obj.flags[i];
+    }
+
+    return count;
+}
+
+/* Marks every cell that the rect, in pixels from the top of the grid,
+ * touches */
+static void observe_rect(
+    unsigned short* cells,
+    const int rows,
+    const SDL_Rect& rect,
+    const unsigned short bit
+) {
+    const int left = SDL_max(rect.x, 0);
+    const int top = SDL_max(rect.y, 0);
+    const int right = SDL_min(rect.x + rect.w, VVVVVV_GRID_WIDTH * 8);
+    const int bottom = SDL_min(rect.y + rect.h, rows * 8);
+
+    if (left >= right || top >= bottom)
+    {
+        return;
+    }
+
+    for (int y = top / 8; y <= (bottom - 1) / 8; y++)
+    {
+        for (int x = left / 8; x <= (right - 1) / 8; x++)
+        {
+            cells[y * VVVVVV_GRID_WIDTH + x] |= bit;
+        }
+    }
+}
+
+static unsigned short entity_bits(const entclass& entity)
+{
+    if (entity.rule == 0)
+    {
+        return VVVVVV_CELL_PLAYER;
+    }
+    if (entity.harmful)
+    {
+        return VVVVVV_CELL_ENEMY;
+    }
+
+    switch (entity.type)
+    {
+    case 1:
+        if (entity.rule != 2)
+        {
+            break;
+        }
+        /* Same test as entityclass::collisioncheck() */
+        if (entity.behave >= 8 && entity.behave < 10)
+        {
+            return VVVVVV_CELL_CONVEYOR;
+        }
+        return VVVVVV_CELL_PLATFORM;
+    case 2:
+    case 3:
+        return VVVVVV_CELL_PLATFORM;
+    case 8:
+        return VVVVVV_CELL_CHECKPOINT;
+    case 9:
+    case 10:
+        return VVVVVV_CELL_GRAVITYLINE;
+    }
+
+    return 0;
+}
+
+static unsigned short block_bits(const blockclass& block)
+{
+    switch (block.type)
+    {
+    case DAMAGE:
+        return VVVVVV_CELL_DAMAGE;
+    case DIRECTIONAL:
+        return VVVVVV_CELL_ONEWAY;
+    case TRIGGER:
+    case ACTIVITY:
+        return VVVVVV_CELL_TRIGGER;
+    }
+
+    return 0;
+}
+
+int VVVVVV_observe(unsigned short* cells, int* y_offset)
+{
+    const int rows = map.towermode ? 31 : 30;
+    /* In the tower, everything's in tower coordinates, and the screen
+     * starts partway through a row */
+    const int first_row = map.towermode ? map.ypos / 8 : 0;
+
+    SDL_memset(cells, 0, VVVVVV_GRID_WIDTH * rows * sizeof(cells[0]));
+    *y_offset = map.towermode ? map.ypos % 8 : 0;
+
+    if (!running)
+    {
+        return rows;
+    }
+
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < VVVVVV_GRID_WIDTH; x++)
+        {
+            unsigned short* cell = &cells[y * VVVVVV_GRID_WIDTH + x];
+
+            if (map.collide(x, first_row + y))
+            {
+                *cell |= VVVVVV_CELL_SOLID;
+            }
+            if (map.towermode && map.spikecollide(x, first_row + y))
+            {
+                *cell |= VVVVVV_CELL_DAMAGE;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < obj.blocks.size(); i++)
+    {
+        const unsigned short bits = block_bits(obj.blocks[i]);
+        if (bits != 0)
+        {
+            SDL_Rect rect = obj.blocks[i].rect;
+            rect.y -= first_row * 8;
+            observe_rect(cells, rows, rect, bits);
+        }
+    }
+
+    for (size_t i = 0; i < obj.entities.size(); i++)
+    {
+        const entclass& entity = obj.entities[i];
+        const unsigned short bits = entity_bits(entity);
+        if (bits != 0)
+        {
+            const SDL_Rect rect = {
+                entity.xp + entity.cx,
+                entity.yp + entity.cy - first_row * 8,
+                entity.w,
+                entity.h
+            };
+            observe_rect(cells, rows, rect, bits);
+        }
+    }
+
+    return rows;
+}
+
+static void save_graphics(GraphicsState* state)
+{
+    state->flipmode = graphics.flipmode;
+    state->fademode = graphics.fademode;
+    state->fadeamount = graphics.fadeamount;
+    state->oldfadeamount = graphics.oldfadeamount;
+    SDL_memcpy(state->fadebars, graphics.fadebars, sizeof(state->fadebars));
+    state->ingame_fademode = graphics.ingame_fademode;
+    state->textboxes = graphics.textboxes;
+    state->showcutscenebars = graphics.showcutscenebars;
+    state->cutscenebarspos = graphics.cutscenebarspos;
+    state->oldcutscenebarspos = graphics.oldcutscenebarspos;
+    state->screenshake_x = graphics.screenshake_x;
+    state->screenshake_y = graphics.screenshake_y;
+    state->crewframe = graphics.crewframe;
+    state->crewframedelay = graphics.crewframedelay;
+    state->trinketcolset = graphics.trinketcolset;
+    state->trinketr = graphics.trinketr;
+    state->trinketg = graphics.trinketg;
+    state->trinketb = graphics.trinketb;
+    state->rcol = graphics.rcol;
+    state->linestate = graphics.linestate;
+    state->linedelay = graphics.linedelay;
+    state->backoffset = graphics.backoffset;
+    state->menuoffset = graphics.menuoffset;
+    state->oldmenuoffset = graphics.oldmenuoffset;
+    state->resumegamemode = graphics.resumegamemode;
+    state->towerbg_bypos = graphics.towerbg.bypos;
+    state->towerbg_bscroll = graphics.towerbg.bscroll;
+    state->towerbg_colstate = graphics.towerbg.colstate;
+    state->towerbg_scrolldir = graphics.towerbg.scrolldir;
+}
+
+static void load_graphics(const GraphicsState* state)
+{
+    graphics.flipmode = state->flipmode;
+    graphics.fademode = state->fademode;
+    graphics.fadeamount = state->fadeamount;
+    graphics.oldfadeamount = state->oldfadeamount;
+    SDL_memcpy(graphics.fadebars, state->fadebars, sizeof(state->fadebars));
+    graphics.ingame_fademode = state->ingame_fademode;
+    graphics.textboxes = state->textboxes;
+    graphics.showcutscenebars = state->showcutscenebars;
+    graphics.cutscenebarspos = state->cutscenebarspos;
+    graphics.oldcutscenebarspos = state->oldcutscenebarspos;
+    graphics.screenshake_x = state->screenshake_x;
+    graphics.screenshake_y = state->screenshake_y;
+    graphics.crewframe = state->crewframe;
+    graphics.crewframedelay = state->crewframedelay;
+    graphics.trinketcolset = state->trinketcolset;
+    graphics.trinketr = state->trinketr;
+    graphics.trinketg = state->trinketg;
+    graphics.trinketb = state->trinketb;
+    graphics.rcol = state->rcol;
+    graphics.linestate = state->linestate;
+    graphics.linedelay = state->linedelay;
+    graphics.backoffset = state->backoffset;
+    graphics.menuoffset = state->menuoffset;
+    graphics.oldmenuoffset = state->oldmenuoffset;
+    graphics.resumegamemode = state->resumegamemode;
+    graphics.towerbg.bypos = state->towerbg_bypos;
+    graphics.towerbg.bscroll = state->towerbg_bscroll;
+    graphics.towerbg.colstate = state->towerbg_colstate;
+    graphics.towerbg.scrolldir = state->towerbg_scrolldir;
+
+    /* Whatever was drawn belongs to some other point in time */
+    graphics.backgrounddrawn = false;
+    graphics.foregrounddrawn = false;
+    graphics.basedrawn = false;
+    graphics.towerbg.tdrawback = true;
+    /* The strips only check map.tower.version, which just went back to a
+     * number some other tower may have had since */
+    graphics.clear_tower_strips();
+}
+
+int VVVVVV_snapshot(void)
+{
+    if (!running)
+    {
+        return -1;
+    }
+
+    const int id = next_snapshot++;
+    Snapshot& snapshot = snapshots[id];
+
+    snapshot.game = game;
+    snapshot.map = map;
+    snapshot.obj = obj;
+    snapshot.script = script;
+    snapshot.help = help;
+    save_graphics(&snapshot.graphics);
+
+    snapshot.gamestate_funcs = engine.gamestate_funcs;
+    snapshot.num_gamestate_funcs = engine.num_gamestate_funcs;
+    snapshot.gamestate_func_index = engine.gamestate_func_index;
+
+    xoshiro_get_state(snapshot.xoshiro);
+    xoshiro_fget_state(snapshot.frandom);
+
+    snapshot.frames = frames;
+
+    return id;
+}
+
+int VVVVVV_restore(const int id)
+{
+    std::map<int, Snapshot>::const_iterator it = snapshots.find(id);
+    if (!running || it == snapshots.end())
+    {
+        return -1;
+    }
+    const Snapshot& snapshot = it->second;
+
+    game = snapshot.game;
+    map = snapshot.map;
+    obj = snapshot.obj;
+    script = snapshot.script;
+    help = snapshot.help;
+    load_graphics(&snapshot.graphics);
+
+    engine.gamestate_funcs = snapshot.gamestate_funcs;
+    engine.num_gamestate_funcs = snapshot.num_gamestate_funcs;
+    engine.gamestate_func_index = snapshot.gamestate_func_index;
+
+    xoshiro_set_state(snapshot.xoshiro);
+    xoshiro_fset_state(snapshot.frandom);
+
+    frames = snapshot.frames;
+
+    return 0;
+}
+
+void VVVVVV_free_snapshot(const int id)
+{
+    snapshots.erase(id);
+}
@@ -0,0 +1,177 @@
+#ifndef LIBVVVVVV_H
+#define LIBVVVVVV_H
+
+/* libvvvvvv: the game as a library, stepped one fixed frame at a time with
+ * no window loop, for tools that need to run it far faster than real time.
+ *
+ * Every thread gets an instance of its own (see EngineContext), so run more
+ * threads to run more games at once. Call everything for an instance from
+ * the thread that called VVVVVV_create() for it; VVVVVV_create() can only
+ * succeed once per thread, and VVVVVV_destroy() is final for that thread.
+ * Setting up and tearing down instances is done one at a time, but stepping
+ * and rendering them isn't.
+ *
+ * The instances in a process share some things: they all need the same
+ * basedir and assets, and a custom level's own assets are mounted for all of
+ * them, so they should only play levels whose assets are the same (or that
+ * have none).
+ *
+ * The game can still end the process itself, the same way the executable
+ * would: on errors it can't recover from, or if it's steered into a quit
+ * option. */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(_WIN32) && defined(LIBVVVVVV_BUILD)
+# define VVVVVV_API __declspec(dllexport)
+#elif defined(__GNUC__)
+# define VVVVVV_API __attribute__((visibility("default")))
+#else
+# define VVVVVV_API
+#endif
+
+/* Buttons for VVVVVV_step(), held down for every frame of the step */
+#define VVVVVV_BUTTON_LEFT (1 << 0)
+#define VVVVVV_BUTTON_RIGHT (1 << 1)
+#define VVVVVV_BUTTON_UP (1 << 2)
+#define VVVVVV_BUTTON_DOWN (1 << 3)
+/* Space: flip, and confirm in menus */
+#define VVVVVV_BUTTON_ACTION (1 << 4)
+/* Enter: the map screen */
+#define VVVVVV_BUTTON_MAP (1 << 5)
+#define VVVVVV_BUTTON_ESCAPE (1 << 6)
+/* E: talk to crewmates, use terminals */
+#define VVVVVV_BUTTON_INTERACT (1 << 7)
+/* R: die and go back to the last checkpoint */
+#define VVVVVV_BUTTON_RESTART (1 << 8)
+
+typedef struct VVVVVV_Options
+{
+    /* Same as -basedir and -assets; NULL for the defaults. These have to be
+     * the same for every instance in the process. */
+    const char* basedir;
+    const char* assets;
+    /* Name of a custom level to play, as for -playing, or NULL to start the
+     * main game with mode instead */
+    const char* level;
+    /* Passed to scriptclass::startgamemode(), e.g. 0 for a new game */
+    int mode;
+    /* Seeds the game's random numbers on every start and reset */
+    unsigned int seed;
+} VVVVVV_Options;
+
+typedef struct VVVVVV_State
+{
+    /* GAMEMODE, TITLEMODE and so on, from Enums.h */
+    int gamestate;
+    /* Fixed frames stepped since the last start or reset */
+    int frames;
+    int room_x;
+    int room_y;
+    /* Everything below is zero if there's no player entity */
+    int has_player;
+    int player_x;
+    int player_y;
+    float player_vx;
+    float player_vy;
+    int player_flipped;
+    int player_onground;
+    int player_dying;
+    int deaths;
+    int trinkets;
+    int crewmates;
+    int num_entities;
+} VVVVVV_State;
+
+typedef struct VVVVVV_Entity
+{
+    int type;
+    int rule;
+    int state;
+    int behave;
+    int x;
+    int y;
+    /* Collision box, relative to x and y */
+    int cx;
+    int cy;
+    int w;
+    int h;
+    float vx;
+    float vy;
+    int harmful;
+    int invis;
+} VVVVVV_Entity;
+
+/* Sets up the game and starts it. Returns 0 on success, or -1 if something
+ * went wrong (logged) or there's already been an instance on this thread. */
+VVVVVV_API int VVVVVV_create(const VVVVVV_Options* options);
+
+VVVVVV_API void VVVVVV_destroy(void);
+
+/* Starts again from the options given to VVVVVV_create() */
+VVVVVV_API int VVVVVV_reset(void);
+
+/* Runs frames fixed frames with buttons held. Nothing is drawn; use
+ * VVVVVV_render() for that. */
+VVVVVV_API int VVVVVV_step(int frames, unsigned int buttons);
+
+/* Draws the current frame and returns its pixels: width by height ARGB8888,
+ * pitch bytes per row, not flipped for flip mode. They're good until the
+ * next call into libvvvvvv. */
+VVVVVV_API const void* VVVVVV_render(int* width, int* height, int* pitch);
+
+VVVVVV_API void VVVVVV_get_state(VVVVVV_State* state);
+
+/* Copies up to max entities and returns how many there are in total */
+VVVVVV_API int VVVVVV_get_entities(VVVVVV_Entity* entities, int max);
+
+/* Copies up to max script flags, one per byte, and returns how many there
+ * are in total */
+VVVVVV_API int VVVVVV_get_flags(unsigned char* flags, int max);
+
+/* The tile grid from VVVVVV_observe(), one cell per 8x8 tile on screen */
+#define VVVVVV_GRID_WIDTH 40
+#define VVVVVV_GRID_MAX_HEIGHT 31
+
+/* What can be in a grid cell, as the game itself sees it (so spikes count
+ * as solid with invincibility on, for instance) */
+#define VVVVVV_CELL_SOLID (1 << 0)
+/* Spikes, and anything else that kills on touch without being an entity */
+#define VVVVVV_CELL_DAMAGE (1 << 1)
+#define VVVVVV_CELL_ONEWAY (1 << 2)
+#define VVVVVV_CELL_CONVEYOR (1 << 3)
+/* Moving, disappearing and breakable platforms */
+#define VVVVVV_CELL_PLATFORM (1 << 4)
+#define VVVVVV_CELL_ENEMY (1 << 5)
+#define VVVVVV_CELL_GRAVITYLINE (1 << 6)
+#define VVVVVV_CELL_CHECKPOINT (1 << 7)
+#define VVVVVV_CELL_PLAYER (1 << 8)
+/* Script triggers, and places a prompt comes up, like terminals */
+#define VVVVVV_CELL_TRIGGER (1 << 9)
+
+/* Fills cells, row by row, with VVVVVV_CELL_* bits for everything in each
+ * tile of the current room. cells must have room for VVVVVV_GRID_WIDTH *
+ * VVVVVV_GRID_MAX_HEIGHT. Returns the number of rows filled: 30, or 31 in
+ * the tower, where the rows line up with the tower's tiles and the first one
+ * starts *y_offset pixels above the top of the screen (otherwise 0).
+ * Entities fill every tile their collision box touches. */
+VVVVVV_API int VVVVVV_observe(unsigned short* cells, int* y_offset);
+
+/* Saves everything the fixed frames work on (game, map, entities, scripts,
+ * fades and textboxes, random numbers) and returns a handle for
+ * VVVVVV_restore(), or -1. Music and custom level data aren't saved.
+ * Snapshots stay around until freed. */
+VVVVVV_API int VVVVVV_snapshot(void);
+
+VVVVVV_API int VVVVVV_restore(int snapshot);
+
+VVVVVV_API void VVVVVV_free_snapshot(int snapshot);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LIBVVVVVV_H */
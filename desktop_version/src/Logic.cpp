@@ -134,7 +134,7 @@ void gamelogic(void)
 #define gotoroom Do not use map.gotoroom directly.
 
     /* Update old lerp positions of entities */
-    {size_t i; for (i = 0; i < obj.entities.size(); ++i)
+    {int i; for (i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
     {
         obj.entities[i].lerpoldxp = obj.entities[i].xp;
         obj.entities[i].lerpoldyp = obj.entities[i].yp;
@@ -142,8 +142,8 @@ void gamelogic(void)
 
     if (!game.blackout && !game.completestop)
     {
-        size_t i;
-        for (i = 0; i < obj.entities.size(); ++i)
+        int i;
+        for (i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
         {
             /* Is this entity on the ground? (needed for jumping) */
             if (obj.entitycollidefloor(i))
@@ -793,7 +793,7 @@ void gamelogic(void)
         {
             if(obj.vertplatforms)
             {
-                for (int i = obj.entities.size() - 1; i >= 0;  i--)
+                for (int i = obj.prevliveentity(obj.entities.size()); i >= 0;  i = obj.prevliveentity(i))
                 {
                     if (!obj.entities[i].isplatform
                     || SDL_abs(obj.entities[i].vx) >= 0.000001f)
@@ -821,7 +821,7 @@ void gamelogic(void)
 
             if(obj.horplatforms)
             {
-                for (int ie = obj.entities.size() - 1; ie >= 0;  ie--)
+                for (int ie = obj.prevliveentity(obj.entities.size()); ie >= 0;  ie = obj.prevliveentity(ie))
                 {
                     if (!obj.entities[ie].isplatform
                     || SDL_abs(obj.entities[ie].vy) >= 0.000001f)
@@ -859,7 +859,7 @@ void gamelogic(void)
                 }
             }
 
-            for (int ie = obj.entities.size() - 1; ie >= 0;  ie--)
+            for (int ie = obj.prevliveentity(obj.entities.size()); ie >= 0;  ie = obj.prevliveentity(ie))
             {
                 if (obj.entities[ie].isplatform)
                 {
@@ -1009,8 +1009,8 @@ void gamelogic(void)
         //Finally: Are we changing room?
         if (map.warpx && !map.towermode)
         {
-            size_t i;
-            for (i = 0; i < obj.entities.size(); ++i)
+            int i;
+            for (i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
             {
                 if ((obj.entities[i].type >= 51
                 && obj.entities[i].type <= 54) /* Don't warp warp lines */
@@ -1067,8 +1067,8 @@ void gamelogic(void)
 
         if (map.warpy && !map.towermode)
         {
-            size_t i;
-            for (i = 0; i < obj.entities.size(); ++i)
+            int i;
+            for (i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
             {
                 if (obj.entities[i].type >= 51
                 && obj.entities[i].type <= 54) /* Don't warp warp lines */
@@ -1099,8 +1099,8 @@ void gamelogic(void)
 
         if (map.warpy && !map.warpx && !map.towermode)
         {
-            size_t i;
-            for (i = 0; i < obj.entities.size(); ++i)
+            int i;
+            for (i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
             {
                 if ((obj.entities[i].type >= 51
                 && obj.entities[i].type <= 54) /* Don't warp warp lines */
@@ -1211,7 +1211,7 @@ void gamelogic(void)
             //Always wrap except for the very top and very bottom of the tower
             if(map.ypos>=500 && map.ypos <=5000)
             {
-                for (size_t i = 0; i < obj.entities.size();  i++)
+                for (int i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
                 {
                     if (obj.entities[i].xp <= -10)
                     {
@@ -948,7 +948,7 @@ void mapclass::gotoroom(int rx, int ry)
 
         if (!player_found)
         {
-            obj.entities.erase(obj.entities.begin() + i);
+            obj.removeentity(i);
         }
         else
         {
@@ -1028,6 +1028,7 @@ void mapclass::gotoroom(int rx, int ry)
         graphics.backgrounddrawn = false; //Used for background caching speedup
     }
     graphics.foregrounddrawn = false; //Used for background caching speedup
+    graphics.prerenderneighbours();
 
     game.prevroomx = game.roomx;
     game.prevroomy = game.roomy;
@@ -3,6 +3,7 @@
 
 #include <vector>
 
+#include "EngineLocal.h"
 #include "Finalclass.h"
 #include "Labclass.h"
 #include "Maths.h"
@@ -173,7 +174,7 @@ public:
 };
 
 #ifndef MAP_DEFINITION
-extern mapclass map;
+extern ENGINE_LOCAL mapclass& map;
 #endif
 
 #endif /* MAPGAME_H */
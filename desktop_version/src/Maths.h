@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 
+#include "Xoshiro.h"
+
 //// This header holds Maths functions that emulate the functionality of flash's
 
 
@@ -10,7 +12,12 @@
 //Returns 0..1
 float inline fRandom(void)
 {
+#ifdef LIBVVVVVV_BUILD
+    /* Snapshots need to be able to read the state back */
+    return xoshiro_frand();
+#else
     return ( float(rand()) / float(RAND_MAX)) ;
+#endif
 }
 
 struct point
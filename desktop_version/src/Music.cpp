@@ -5,6 +5,7 @@
 #include <physfsrwops.h>
 
 #include "BinaryBlob.h"
+#include "Capture.h"
 #include "FileSystemUtils.h"
 #include "Game.h"
 #include "Graphics.h"
@@ -16,18 +17,317 @@
 /* Begin SDL_mixer wrapper */
 
 #include <SDL_mixer.h>
+#include <map>
 #include <vector>
 
 #define VVV_MAX_VOLUME MIX_MAX_VOLUME
 
+/* Sound effects, already decoded and converted to the output format, keyed
+ * by a hash of the WAV file they came from. This outlives
+ * musicclass::destroy(), so reloading assets (e.g. entering and leaving a
+ * custom level) doesn't decode and resample every sound again. The chunks
+ * are handed to Mix_PlayChannel() as-is.
+ *
+ * Every musicclass::init() is a new generation. Once the cache takes up
+ * more than SOUND_CACHE_MAX_BYTES, sounds from the oldest generations are
+ * dropped, but never ones the current soundTracks use. The on-disk cache
+ * holds whatever's left. */
+struct SoundCacheEntry
+{
+    Mix_Chunk* chunk;
+    Uint32 generation;
+};
+static std::map<Uint64, SoundCacheEntry> sound_cache;
+static size_t sound_cache_bytes = 0;
+static Uint32 sound_cache_generation = 1;
+
+#define SOUND_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+/* Set when sound_cache differs from the on-disk cache */
+static bool sound_cache_dirty = false;
+
+/* Set once the on-disk cache has been read this run */
+static bool sound_cache_file_loaded = false;
+
+#define SOUND_CACHE_FILE "saves/soundcache.vvv"
+#define SOUND_CACHE_MAGIC "VVVSFX\x01"
+#define SOUND_CACHE_HEADER_SIZE 24
+#define SOUND_CACHE_ENTRY_SIZE 16
+
+/* 64-bit FNV-1a */
+static Uint64 hash_asset(const unsigned char* data, const size_t length)
+{
+    Uint64 hash = ((Uint64) 0xCBF29CE4 << 32) | 0x84222325;
+    const Uint64 prime = ((Uint64) 0x100 << 32) | 0x000001B3;
+    size_t i;
+
+    for (i = 0; i < length; ++i)
+    {
+        hash ^= data[i];
+        hash *= prime;
+    }
+
+    return hash;
+}
+
+/* Also marks the sound as used by the current generation */
+static Mix_Chunk* sound_cache_lookup(const Uint64 hash)
+{
+    std::map<Uint64, SoundCacheEntry>::iterator it = sound_cache.find(hash);
+    if (it == sound_cache.end())
+    {
+        return NULL;
+    }
+    it->second.generation = sound_cache_generation;
+    return it->second.chunk;
+}
+
+static void sound_cache_add(const Uint64 hash, Mix_Chunk* chunk, const Uint32 generation)
+{
+    SoundCacheEntry entry;
+
+    entry.chunk = chunk;
+    entry.generation = generation;
+    sound_cache[hash] = entry;
+    sound_cache_bytes += chunk->alen;
+}
+
+/* Drops the least recently used sounds until the cache fits again */
+static void sound_cache_trim(void)
+{
+    while (sound_cache_bytes > SOUND_CACHE_MAX_BYTES)
+    {
+        std::map<Uint64, SoundCacheEntry>::iterator oldest = sound_cache.end();
+        std::map<Uint64, SoundCacheEntry>::iterator it;
+
+        for (it = sound_cache.begin(); it != sound_cache.end(); ++it)
+        {
+            if (it->second.generation != sound_cache_generation
+            && (oldest == sound_cache.end()
+            || it->second.generation < oldest->second.generation))
+            {
+                oldest = it;
+            }
+        }
+        if (oldest == sound_cache.end())
+        {
+            /* Everything left is in use */
+            break;
+        }
+
+        sound_cache_bytes -= oldest->second.chunk->alen;
+        Mix_FreeChunk(oldest->second.chunk);
+        sound_cache.erase(oldest);
+        sound_cache_dirty = true;
+    }
+}
+
+static bool sound_cache_spec(Sint32* freq, Uint16* format, Uint16* channels)
+{
+    int query_freq;
+    Uint16 query_format;
+    int query_channels;
+
+    if (Mix_QuerySpec(&query_freq, &query_format, &query_channels) == 0)
+    {
+        return false;
+    }
+
+    *freq = query_freq;
+    *format = query_format;
+    *channels = query_channels;
+    return true;
+}
+
+/* File layout, native byte order since it never leaves this machine:
+ *   char magic[8]; Sint32 freq; Uint16 format; Uint16 channels;
+ *   Uint32 count; Uint32 reserved;
+ * then count times:
+ *   Uint64 hash; Uint32 length; Uint32 reserved; Uint8 data[length];
+ * Every length is a multiple of the sample frame size, so the PCM stays
+ * aligned. Each sound is copied out of the loaded file into a chunk that
+ * owns it, so dropping a sound from the cache really frees it, and the
+ * file itself doesn't stay in memory. */
+static void sound_cache_load_file(void)
+{
+    unsigned char* mem;
+    size_t length;
+    size_t offset;
+    Sint32 freq, file_freq;
+    Uint16 format, file_format;
+    Uint16 channels, file_channels;
+    Uint32 count;
+    Uint32 i;
+
+    if (sound_cache_file_loaded || !sound_cache_spec(&freq, &format, &channels))
+    {
+        return;
+    }
+    sound_cache_file_loaded = true;
+
+    FILESYSTEM_loadFileToMemory(SOUND_CACHE_FILE, &mem, &length, false);
+    if (mem == NULL)
+    {
+        return;
+    }
+
+    if (length < SOUND_CACHE_HEADER_SIZE
+    || SDL_memcmp(mem, SOUND_CACHE_MAGIC, 8) != 0)
+    {
+        vlog_warn("Ignoring invalid sound cache %s", SOUND_CACHE_FILE);
+        goto fail;
+    }
+
+    SDL_memcpy(&file_freq, &mem[8], sizeof(file_freq));
+    SDL_memcpy(&file_format, &mem[12], sizeof(file_format));
+    SDL_memcpy(&file_channels, &mem[14], sizeof(file_channels));
+    SDL_memcpy(&count, &mem[16], sizeof(count));
+
+    if (file_freq != freq || file_format != format || file_channels != channels)
+    {
+        /* Audio output changed, it'll get rewritten */
+        goto fail;
+    }
+
+    offset = SOUND_CACHE_HEADER_SIZE;
+    for (i = 0; i < count; ++i)
+    {
+        Uint64 hash;
+        Uint32 chunk_length;
+        Mix_Chunk* chunk;
+
+        if (length - offset < SOUND_CACHE_ENTRY_SIZE)
+        {
+            break;
+        }
+        SDL_memcpy(&hash, &mem[offset], sizeof(hash));
+        SDL_memcpy(&chunk_length, &mem[offset + 8], sizeof(chunk_length));
+        offset += SOUND_CACHE_ENTRY_SIZE;
+
+        if (length - offset < chunk_length)
+        {
+            break;
+        }
+
+        if (sound_cache.find(hash) == sound_cache.end())
+        {
+            Uint8* pcm = (Uint8*) SDL_malloc(chunk_length);
+            chunk = NULL;
+            if (pcm != NULL)
+            {
+                SDL_memcpy(pcm, &mem[offset], chunk_length);
+                chunk = Mix_QuickLoad_RAW(pcm, chunk_length);
+            }
+            if (chunk != NULL)
+            {
+                /* Mix_FreeChunk() frees the copy along with the chunk */
+                chunk->allocated = 1;
+
+                /* Older than anything used since, so it's the first to go
+                 * if it turns out not to be needed */
+                sound_cache_add(hash, chunk, 0);
+            }
+            else
+            {
+                SDL_free(pcm);
+            }
+        }
+        offset += chunk_length;
+    }
+
+    if (i < count)
+    {
+        vlog_warn("Sound cache %s is truncated", SOUND_CACHE_FILE);
+        sound_cache_dirty = true;
+    }
+
+    FILESYSTEM_freeMemory(&mem);
+    return;
+
+fail:
+    FILESYSTEM_freeMemory(&mem);
+    sound_cache_dirty = true;
+}
+
+static void sound_cache_save_file(void)
+{
+    Sint32 freq;
+    Uint16 format;
+    Uint16 channels;
+    Uint32 count = 0;
+    size_t length = SOUND_CACHE_HEADER_SIZE;
+    size_t offset;
+    unsigned char* mem;
+    std::map<Uint64, SoundCacheEntry>::const_iterator it;
+
+    if (!sound_cache_dirty || !sound_cache_spec(&freq, &format, &channels))
+    {
+        return;
+    }
+
+    for (it = sound_cache.begin(); it != sound_cache.end(); ++it)
+    {
+        length += SOUND_CACHE_ENTRY_SIZE + it->second.chunk->alen;
+        count++;
+    }
+
+    mem = (unsigned char*) SDL_calloc(1, length);
+    if (mem == NULL)
+    {
+        return;
+    }
+
+    SDL_memcpy(mem, SOUND_CACHE_MAGIC, 8);
+    SDL_memcpy(&mem[8], &freq, sizeof(freq));
+    SDL_memcpy(&mem[12], &format, sizeof(format));
+    SDL_memcpy(&mem[14], &channels, sizeof(channels));
+    SDL_memcpy(&mem[16], &count, sizeof(count));
+
+    offset = SOUND_CACHE_HEADER_SIZE;
+    for (it = sound_cache.begin(); it != sound_cache.end(); ++it)
+    {
+        const Uint32 chunk_length = it->second.chunk->alen;
+        SDL_memcpy(&mem[offset], &it->first, sizeof(it->first));
+        SDL_memcpy(&mem[offset + 8], &chunk_length, sizeof(chunk_length));
+        offset += SOUND_CACHE_ENTRY_SIZE;
+        SDL_memcpy(&mem[offset], it->second.chunk->abuf, chunk_length);
+        offset += chunk_length;
+    }
+
+    if (FILESYSTEM_saveFile(SOUND_CACHE_FILE, mem, length))
+    {
+        sound_cache_dirty = false;
+    }
+    else
+    {
+        vlog_warn("Unable to write sound cache %s", SOUND_CACHE_FILE);
+    }
+
+    SDL_free(mem);
+}
+
+static void sound_cache_free(void)
+{
+    std::map<Uint64, SoundCacheEntry>::iterator it;
+
+    /* Mix_FreeChunk() halts any channel still playing the chunk */
+    for (it = sound_cache.begin(); it != sound_cache.end(); ++it)
+    {
+        Mix_FreeChunk(it->second.chunk);
+    }
+    sound_cache.clear();
+    sound_cache_bytes = 0;
+    sound_cache_file_loaded = false;
+}
+
 class SoundTrack
 {
 public:
     SoundTrack(const char* fileName)
     {
-        /* SDL_LoadWAV, convert spec to FAudioBuffer */
         unsigned char *mem;
         size_t length;
+        Uint64 hash;
         FILESYSTEM_loadAssetToMemory(fileName, &mem, &length, false);
         if (mem == NULL)
         {
@@ -36,8 +336,20 @@ public:
             SDL_assert(0 && "WAV file missing!");
             return;
         }
-        SDL_RWops *fileIn = SDL_RWFromConstMem(mem, length);
-        m_sound = Mix_LoadWAV_RW(fileIn, 1);
+
+        hash = hash_asset(mem, length);
+        m_sound = sound_cache_lookup(hash);
+        if (m_sound == NULL)
+        {
+            SDL_RWops *fileIn = SDL_RWFromConstMem(mem, length);
+            m_sound = Mix_LoadWAV_RW(fileIn, 1);
+
+            if (m_sound != NULL)
+            {
+                sound_cache_add(hash, m_sound, sound_cache_generation);
+                sound_cache_dirty = true;
+            }
+        }
         FILESYSTEM_freeMemory(&mem);
 
         if (m_sound == NULL)
@@ -48,8 +360,8 @@ public:
 
     void Dispose()
     {
-        /* Destroy all track voices, SDL_free buffer from LoadWAV */
-        Mix_FreeChunk(m_sound);
+        /* The chunk itself belongs to sound_cache */
+        m_sound = NULL;
     }
 
     void Play()
@@ -102,24 +414,46 @@ private:
 class MusicTrack
 {
 public:
-    MusicTrack(SDL_RWops *rw)
+    MusicTrack(binaryBlob* blob, const int index)
     {
-        /* Open an stb_vorbis handle */
-        m_music = Mix_LoadMUS_RW(rw, 1);
-        if (m_music == NULL)
-        {
-            vlog_error("Unable to load Magic Binary Music file: %s", Mix_GetError());
-        }
+        m_blob = blob;
+        m_index = index;
+        m_path = NULL;
+        m_music = NULL;
+        last_used = 0;
+    }
+
+    MusicTrack(const char* path)
+    {
+        m_blob = NULL;
+        m_index = -1;
+        m_path = path;
+        m_music = NULL;
+        last_used = 0;
+    }
+
+    bool IsLoaded()
+    {
+        return m_music != NULL;
     }
 
     void Dispose()
     {
         /* Free stb_vorbis */
-        Mix_FreeMusic(m_music);
+        if (m_music != NULL)
+        {
+            Mix_FreeMusic(m_music);
+            m_music = NULL;
+        }
     }
 
     bool Play(bool loop)
     {
+        if (!Load())
+        {
+            return false;
+        }
+
         /* Create/Validate static FAudioSourceVoice, begin streaming */
         if (Mix_PlayMusic(m_music, loop ? -1 : 0) == -1)
         {
@@ -159,15 +493,121 @@ public:
         Mix_VolumeMusic(musicVolume);
     }
 
+    /* When this track was last started, see musicclass::play() */
+    Uint32 last_used;
+
 private:
+    bool Load()
+    {
+        SDL_RWops* rw;
+
+        if (m_music != NULL)
+        {
+            return true;
+        }
+
+        /* Only now do we touch the actual data. Blobs are either mapped
+         * (so this is free) or get a PhysFS handle just for this track. */
+        if (m_blob != NULL)
+        {
+            rw = m_blob->openTrack(m_index);
+        }
+        else
+        {
+            rw = PHYSFSRWOPS_openRead(m_path);
+        }
+
+        if (rw == NULL)
+        {
+            vlog_error("Unable to read music file header: %s", SDL_GetError());
+            return false;
+        }
+
+        /* Open an stb_vorbis handle */
+        m_music = Mix_LoadMUS_RW(rw, 1);
+        if (m_music == NULL)
+        {
+            vlog_error("Unable to load Magic Binary Music file: %s", Mix_GetError());
+            return false;
+        }
+        return true;
+    }
+
+    binaryBlob* m_blob;
+    int m_index;
+    const char* m_path;
     Mix_Music *m_music;
 };
 
-static std::vector<SoundTrack> soundTracks;
-static std::vector<MusicTrack> musicTracks;
+static ENGINE_LOCAL std::vector<SoundTrack> soundTracks;
+static ENGINE_LOCAL std::vector<MusicTrack> musicTracks;
+
+static void SDLCALL capture_post_mix(void* udata, Uint8* stream, int len)
+{
+    (void) udata;
+    CAPTURE_audio(stream, len);
+}
 
 /* End SDL_mixer wrapper */
 
+/* Tracks are opened on first play. This is how many we keep open after that,
+ * counting the one that's playing; the least recently played go first. */
+#define MAX_LOADED_TRACKS 3
+
+static ENGINE_LOCAL Uint32 track_play_count = 0;
+
+static void release_stale_tracks(const int playing)
+{
+    size_t num_loaded = 0;
+    size_t i;
+
+    for (i = 0; i < musicTracks.size(); ++i)
+    {
+        if (musicTracks[i].IsLoaded())
+        {
+            ++num_loaded;
+        }
+    }
+
+    while (num_loaded > MAX_LOADED_TRACKS)
+    {
+        int oldest = -1;
+
+        for (i = 0; i < musicTracks.size(); ++i)
+        {
+            if ((int) i == playing || !musicTracks[i].IsLoaded())
+            {
+                continue;
+            }
+            if (oldest == -1 || musicTracks[i].last_used < musicTracks[oldest].last_used)
+            {
+                oldest = i;
+            }
+        }
+
+        if (oldest == -1)
+        {
+            break;
+        }
+
+        musicTracks[oldest].Dispose();
+        --num_loaded;
+    }
+}
+
+static bool play_track(const int t, const bool loop)
+{
+    if (!musicTracks[t].Play(loop))
+    {
+        return false;
+    }
+
+    /* Only safe now that the previous track isn't playing anymore */
+    musicTracks[t].last_used = ++track_play_count;
+    release_stale_tracks(t);
+    return true;
+}
+
 musicclass::musicclass(void)
 {
     SoundTrack::Init(44100, 2);
@@ -186,10 +626,21 @@ musicclass::musicclass(void)
     quick_fade = true;
 
     usingmmmmmm = false;
+    sound_cache_file = false;
 }
 
 void musicclass::init(void)
 {
+    /* The sound cache is shared by every libvvvvvv instance */
+    const EngineProcessLock lock;
+
+    sound_cache_generation++;
+
+    if (sound_cache_file)
+    {
+        sound_cache_load_file();
+    }
+
     soundTracks.push_back(SoundTrack( "sounds/jump.wav" ));
     soundTracks.push_back(SoundTrack( "sounds/jump2.wav" ));
     soundTracks.push_back(SoundTrack( "sounds/hurt.wav" ));
@@ -219,6 +670,13 @@ void musicclass::init(void)
     soundTracks.push_back(SoundTrack( "sounds/trophy.wav" ));
     soundTracks.push_back(SoundTrack( "sounds/rescue.wav" ));
 
+    sound_cache_trim();
+
+    if (sound_cache_file)
+    {
+        sound_cache_save_file();
+    }
+
 #ifdef VVV_COMPILEMUSIC
     binaryBlob musicWriteBlob;
 #define FOREACH_TRACK(blob, track_name) blob.AddFileToBinaryBlob("data/" track_name);
@@ -242,12 +700,10 @@ void musicclass::init(void)
             usingmmmmmm=false;
 
             int index;
-            SDL_RWops* rw;
 
 #define FOREACH_TRACK(blob, track_name) \
     index = blob.getIndex("data/" track_name); \
-    rw = SDL_RWFromMem(blob.getAddress(index), blob.getSize(index)); \
-    musicTracks.push_back(MusicTrack( rw ));
+    musicTracks.push_back(MusicTrack( &blob, index ));
 
             TRACK_NAMES(pppppp_blob)
 
@@ -257,10 +713,8 @@ void musicclass::init(void)
         {
             vlog_info("Loading music from loose files...");
 
-            SDL_RWops* rw;
 #define FOREACH_TRACK(_, track_name) \
-    rw = PHYSFSRWOPS_openRead(track_name); \
-    musicTracks.push_back(MusicTrack( rw ));
+    musicTracks.push_back(MusicTrack( track_name ));
 
             TRACK_NAMES(_)
 
@@ -273,21 +727,12 @@ void musicclass::init(void)
 
         mmmmmm = true;
         int index;
-        SDL_RWops *rw;
 
 #define FOREACH_TRACK(blob, track_name) \
     index = blob.getIndex("data/" track_name); \
     if (index >= 0 && index < blob.max_headers) \
     { \
-        rw = SDL_RWFromConstMem(blob.getAddress(index), blob.getSize(index)); \
-        if (rw == NULL) \
-        { \
-            vlog_error("Unable to read music file header: %s", SDL_GetError()); \
-        } \
-        else \
-        { \
-            musicTracks.push_back(MusicTrack( rw )); \
-        } \
+        musicTracks.push_back(MusicTrack( &blob, index )); \
     }
 
         TRACK_NAMES(mmmmmm_blob)
@@ -297,8 +742,7 @@ void musicclass::init(void)
         size_t index_ = 0;
         while (mmmmmm_blob.nextExtra(&index_))
         {
-            rw = SDL_RWFromConstMem(mmmmmm_blob.getAddress(index_), mmmmmm_blob.getSize(index_));
-            musicTracks.push_back(MusicTrack( rw ));
+            musicTracks.push_back(MusicTrack( &mmmmmm_blob, index_ ));
 
             num_mmmmmm_tracks++;
             index_++;
@@ -314,12 +758,10 @@ void musicclass::init(void)
 
     num_pppppp_tracks += musicTracks.size() - num_mmmmmm_tracks;
 
-    SDL_RWops* rw;
     size_t index_ = 0;
     while (pppppp_blob.nextExtra(&index_))
     {
-        rw = SDL_RWFromConstMem(pppppp_blob.getAddress(index_), pppppp_blob.getSize(index_));
-        musicTracks.push_back(MusicTrack( rw ));
+        musicTracks.push_back(MusicTrack( &pppppp_blob, index_ ));
 
         num_pppppp_tracks++;
         index_++;
@@ -348,6 +790,14 @@ void musicclass::destroy(void)
     mmmmmm_blob.clear();
 }
 
+void musicclass::deinit(void)
+{
+    const EngineProcessLock lock;
+
+    destroy();
+    sound_cache_free();
+}
+
 void musicclass::play(int t)
 {
     if (mmmmmm && usingmmmmmm)
@@ -392,7 +842,7 @@ void musicclass::play(int t)
     if (currentsong == 0 || currentsong == 7 || (!map.custommode && (currentsong == 0+num_mmmmmm_tracks || currentsong == 7+num_mmmmmm_tracks)))
     {
         // Level Complete theme, no fade in or repeat
-        if (musicTracks[t].Play(false))
+        if (play_track(t, false))
         {
             m_doFadeInVol = false;
             m_doFadeOutVol = false;
@@ -418,7 +868,7 @@ void musicclass::play(int t)
                 quick_fade = true;
             }
         }
-        else if (musicTracks[t].Play(true))
+        else if (play_track(t, true))
         {
             m_doFadeInVol = false;
             m_doFadeOutVol = false;
@@ -472,7 +922,7 @@ struct FadeState
     int step_ms;
 };
 
-static struct FadeState fade;
+static ENGINE_LOCAL struct FadeState fade;
 
 enum FadeCode
 {
@@ -735,3 +1185,28 @@ void musicclass::updatemutestate(void)
         }
     }
 }
+
+void musicclass::setcapture(const bool enabled)
+{
+    if (enabled)
+    {
+        int freq;
+        Uint16 format;
+        int channels;
+        if (Mix_QuerySpec(&freq, &format, &channels) == 0)
+        {
+            vlog_warn("Audio isn't open, so it won't be captured.");
+            return;
+        }
+        vlog_info(
+            "Capturing audio at %i Hz, %i channels, format 0x%04X",
+            freq,
+            channels,
+            format
+        );
+    }
+
+    /* This locks the audio device, so once it returns the old callback
+     * isn't running anymore */
+    Mix_SetPostMix(enabled ? capture_post_mix : NULL, NULL);
+}
@@ -2,6 +2,7 @@
 #define MUSIC_H
 
 #include "BinaryBlob.h"
+#include "EngineLocal.h"
 
 #define musicroom(rx, ry) ((rx) + ((ry) * 20))
 
@@ -17,6 +18,7 @@ public:
     musicclass(void);
     void init(void);
     void destroy(void);
+    void deinit(void);
 
     void play(int t);
     void resume();
@@ -44,6 +46,9 @@ public:
     bool halted(void);
     void updatemutestate(void);
 
+    /* Feeds the final mix to CAPTURE_audio() */
+    void setcapture(bool enabled);
+
     bool safeToProcessMusic;
 
     int nicechange; // -1 if no song queued
@@ -59,6 +64,9 @@ public:
 
     bool quick_fade;
 
+    /* Also keep converted sound effects in saves/, not just in memory */
+    bool sound_cache_file;
+
     // MMMMMM mod settings
     bool mmmmmm;
     bool usingmmmmmm;
@@ -70,7 +78,7 @@ public:
 };
 
 #ifndef MUSIC_DEFINITION
-extern musicclass music;
+extern ENGINE_LOCAL musicclass& music;
 #endif
 
 #endif /* MUSIC_H */
@@ -0,0 +1,163 @@
+#include "PlaytestFifo.h"
+
+#include <SDL.h>
+#include <string>
+
+#include "Engine.h"
+#include "Vlogging.h"
+
+#if !defined(__EMSCRIPTEN__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__unix__))
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_FIFO
+#endif
+
+#ifdef HAVE_FIFO
+
+/* Longer lines than this are thrown away */
+#define MAX_COMMAND 4096
+
+static int read_fd = -1;
+/* Held open so the pipe never runs out of writers, which would make every
+ * read return end-of-file until the next one opens it */
+static int write_fd = -1;
+static std::string pending;
+static bool overlong = false;
+
+bool PLAYTESTFIFO_init(const char* path)
+{
+    struct stat info;
+
+    if (mkfifo(path, 0600) != 0 && errno != EEXIST)
+    {
+        vlog_error("Could not create playtest pipe %s: %s", path, strerror(errno));
+        return false;
+    }
+    if (stat(path, &info) != 0 || !S_ISFIFO(info.st_mode))
+    {
+        vlog_error("%s is already there and isn't a pipe.", path);
+        return false;
+    }
+
+    read_fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (read_fd != -1)
+    {
+        write_fd = open(path, O_WRONLY | O_NONBLOCK);
+    }
+    if (read_fd == -1 || write_fd == -1)
+    {
+        vlog_error("Could not open playtest pipe %s: %s", path, strerror(errno));
+        PLAYTESTFIFO_quit();
+        return false;
+    }
+
+    vlog_info("Taking playtest commands from %s", path);
+    return true;
+}
+
+void PLAYTESTFIFO_quit(void)
+{
+    if (read_fd != -1)
+    {
+        close(read_fd);
+        read_fd = -1;
+    }
+    if (write_fd != -1)
+    {
+        close(write_fd);
+        write_fd = -1;
+    }
+    pending.clear();
+}
+
+static void run_command(const std::string& line)
+{
+    PlaytestRequest request;
+    std::string error;
+
+    if (!ENGINE_parse_playtest(line, NULL, &request, &error))
+    {
+        vlog_error("Playtest command: %s", error.c_str());
+        return;
+    }
+
+    vlog_info("Playtesting %s", request.level.c_str());
+    if (!ENGINE_start_playtest(request))
+    {
+        vlog_error("Playtest command: level %s not found", request.level.c_str());
+    }
+}
+
+void PLAYTESTFIFO_update(void)
+{
+    char buffer[1024];
+
+    if (read_fd == -1)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        const ssize_t got = read(read_fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            /* EAGAIN, most likely: nothing more for now */
+            break;
+        }
+
+        for (ssize_t i = 0; i < got; i++)
+        {
+            if (buffer[i] != '\n')
+            {
+                if (pending.size() < MAX_COMMAND)
+                {
+                    pending += buffer[i];
+                }
+                else
+                {
+                    overlong = true;
+                }
+                continue;
+            }
+
+            if (overlong)
+            {
+                vlog_error("Playtest command too long, ignoring it");
+            }
+            else
+            {
+                run_command(pending);
+            }
+            pending.clear();
+            overlong = false;
+        }
+    }
+}
+
+#else /* HAVE_FIFO */
+
+bool PLAYTESTFIFO_init(const char* path)
+{
+    (void) path;
+
+    vlog_error("Playtest pipes aren't supported on this platform.");
+    return false;
+}
+
+void PLAYTESTFIFO_quit(void)
+{
+}
+
+void PLAYTESTFIFO_update(void)
+{
+}
+
+#endif /* HAVE_FIFO */
@@ -0,0 +1,21 @@
+#ifndef PLAYTESTFIFO_H
+#define PLAYTESTFIFO_H
+
+/* Takes playtest commands from a named pipe while the game runs, so an
+ * editor can keep one game open and swap levels into it instead of starting
+ * the game again for every playtest.
+ *
+ * Each command is one line in the format of PlaytestRequest (see Engine.h),
+ * e.g. "level=mylevel x=100 y=80 rx=2 ry=3 gc=0". Whatever's going on in the
+ * game at the time is dropped, and the level is reloaded from disk, along
+ * with its assets if anything in them has changed. Bad commands are logged
+ * and otherwise ignored. */
+bool PLAYTESTFIFO_init(const char* path);
+
+void PLAYTESTFIFO_quit(void);
+
+/* Runs any commands that have come in since the last call. Call once per
+ * frame. */
+void PLAYTESTFIFO_update(void);
+
+#endif /* PLAYTESTFIFO_H */
@@ -3,6 +3,7 @@
 #include "Constants.h"
 #include "Credits.h"
 #include "CustomLevels.h"
+#include "DrawList.h"
 #include "Editor.h"
 #include "Entity.h"
 #include "FileSystemUtils.h"
@@ -19,9 +20,9 @@
 #include "UtilityClass.h"
 #include "Version.h"
 
-static int tr;
-static int tg;
-static int tb;
+static ENGINE_LOCAL int tr;
+static ENGINE_LOCAL int tg;
+static ENGINE_LOCAL int tb;
 
 static inline void drawslowdowntext(void)
 {
@@ -1668,12 +1669,57 @@ static const char* interact_prompt(
     return buffer;
 }
 
-void gamerender(void)
+/* Whether gamerender()'s background and map look the same however far we
+ * are between fixed steps, and there can be more than one render per step,
+ * so they're worth drawing once per step */
+static bool gamebase_is_static(void)
 {
+    if (!game.over30mode)
+    {
+        /* Only one render per step, and renderfixedpost() throws the copy
+         * away before the next, so caching would only cost a blit */
+        return false;
+    }
 
+    if (map.towermode)
+    {
+        return false;
+    }
 
+    if (game.colourblindmode)
+    {
+        return true;
+    }
 
-    if(!game.blackout)
+    switch (map.background)
+    {
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+    case 6:
+        /* Stars, lab boxes and warp scrolling are interpolated */
+        return false;
+    default:
+        return true;
+    }
+}
+
+void gamerender(void)
+{
+    DRAWLIST_begin(graphics.backBuffer);
+
+    if(!game.blackout && graphics.basedrawn)
+    {
+        BlitSurfaceStandard(graphics.baseBuffer, NULL, graphics.backBuffer, NULL);
+
+        graphics.drawentities();
+        if (map.towermode)
+        {
+            graphics.drawtowerspikes();
+        }
+    }
+    else if(!game.blackout)
     {
 
         if (map.towermode)
@@ -1708,6 +1754,11 @@ void gamerender(void)
             }
         }
 
+        if (gamebase_is_static())
+        {
+            BlitSurfaceStandard(graphics.backBuffer, NULL, graphics.baseBuffer, NULL);
+            graphics.basedrawn = true;
+        }
 
         graphics.drawentities();
         if (map.towermode)
@@ -1741,7 +1792,7 @@ void gamerender(void)
 
         if (graphics.translucentroomname)
         {
-            SDL_BlitSurface(graphics.footerbuffer, NULL, graphics.backBuffer, &graphics.footerrect);
+            BlitSurfaceStandard(graphics.footerbuffer, NULL, graphics.backBuffer, &graphics.footerrect);
             graphics.bprint(5, 231, roomname, 196, 196, 255 - help.glow, true);
         }
         else
@@ -2009,7 +2060,7 @@ void gamerender(void)
         graphics.drawtrophytext();
     }
 
-
+    /* Ends the draw list */
     graphics.renderwithscreeneffects();
 }
 
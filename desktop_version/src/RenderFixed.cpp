@@ -25,7 +25,7 @@ void gamerenderfixed(void)
 {
     if (!game.blackout && !game.completestop)
     {
-        for (size_t i = 0; i < obj.entities.size(); i++)
+        for (int i = obj.nextliveentity(-1); i >= 0; i = obj.nextliveentity(i))
         {
             if (obj.entitycollidefloor(i))
             {
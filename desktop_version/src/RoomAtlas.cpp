@@ -0,0 +1,307 @@
+#include "RoomAtlas.h"
+
+#include <SDL.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Constants.h"
+#include "CustomLevels.h"
+#include "Entity.h"
+#include "FileSystemUtils.h"
+#include "Game.h"
+#include "Graphics.h"
+#include "GraphicsUtil.h"
+#include "Map.h"
+#include "Script.h"
+#include "UtilityClass.h"
+#include "Vlogging.h"
+
+// Used to save PNG data
+extern "C"
+{
+    extern unsigned lodepng_encode32(
+        unsigned char** out,
+        size_t* outsize,
+        const unsigned char* image,
+        unsigned w,
+        unsigned h
+    );
+    extern const char* lodepng_error_text(unsigned code);
+}
+
+struct AtlasImage
+{
+    std::string path;
+    int width;
+    int height;
+    /* ARGB8888, as drawn */
+    std::vector<Uint32> pixels;
+};
+
+static SDL_mutex* lock = NULL;
+static SDL_cond* wake = NULL;
+static SDL_cond* taken = NULL;
+
+/* Everything below is guarded by lock */
+static std::deque<AtlasImage> pending;
+static bool finishing = false;
+static int failures = 0;
+
+static bool save_image(const AtlasImage& image)
+{
+    std::vector<unsigned char> rgba(image.pixels.size() * 4);
+    unsigned char* png = NULL;
+    size_t png_size = 0;
+
+    /* The screen texture is drawn over black, so do the same here */
+    for (size_t i = 0; i < image.pixels.size(); i++)
+    {
+        const Uint32 pixel = image.pixels[i];
+        const Uint32 alpha = pixel >> 24;
+        rgba[i * 4 + 0] = ((pixel >> 16) & 0xFF) * alpha / 255;
+        rgba[i * 4 + 1] = ((pixel >> 8) & 0xFF) * alpha / 255;
+        rgba[i * 4 + 2] = (pixel & 0xFF) * alpha / 255;
+        rgba[i * 4 + 3] = 255;
+    }
+
+    const unsigned error = lodepng_encode32(&png, &png_size, &rgba[0], image.width, image.height);
+    if (error != 0)
+    {
+        vlog_error("Could not encode %s: %s", image.path.c_str(), lodepng_error_text(error));
+        return false;
+    }
+
+    const bool saved = FILESYSTEM_saveFile(image.path.c_str(), png, png_size);
+    SDL_free(png);
+    if (!saved)
+    {
+        vlog_error("Could not save %s", image.path.c_str());
+    }
+    return saved;
+}
+
+static int SDLCALL worker_main(void* unused)
+{
+    (void) unused;
+
+    SDL_LockMutex(lock);
+    while (true)
+    {
+        while (!finishing && pending.empty())
+        {
+            SDL_CondWait(wake, lock);
+        }
+        if (pending.empty())
+        {
+            break;
+        }
+
+        AtlasImage image;
+        image.path.swap(pending.front().path);
+        image.width = pending.front().width;
+        image.height = pending.front().height;
+        image.pixels.swap(pending.front().pixels);
+        pending.pop_front();
+        SDL_CondSignal(taken);
+        SDL_UnlockMutex(lock);
+
+        const bool saved = save_image(image);
+
+        SDL_LockMutex(lock);
+        if (!saved)
+        {
+            failures++;
+        }
+    }
+    SDL_UnlockMutex(lock);
+
+    return 0;
+}
+
+/* Hands image to the workers, leaving it empty. Waits if they're already
+ * too far behind, so the whole map doesn't pile up in memory. */
+static void queue_image(AtlasImage& image, const size_t max_pending)
+{
+    SDL_LockMutex(lock);
+    while (pending.size() >= max_pending)
+    {
+        SDL_CondWait(taken, lock);
+    }
+    pending.push_back(AtlasImage());
+    pending.back().path.swap(image.path);
+    pending.back().width = image.width;
+    pending.back().height = image.height;
+    pending.back().pixels.swap(image.pixels);
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+}
+
+static void draw_room(void)
+{
+    ClearSurface(graphics.backBuffer);
+
+    if (!game.colourblindmode)
+    {
+        /* Warp backgrounds come out of warpbuffer, which only
+         * updatebackground() draws, so start it afresh for every room */
+        graphics.backgrounddrawn = false;
+        graphics.updatebackground(map.background);
+        graphics.drawbackground(map.background);
+    }
+    if (map.final_colormode)
+    {
+        graphics.drawfinalmap();
+    }
+    else
+    {
+        graphics.drawmap();
+    }
+    graphics.drawentities();
+}
+
+static void copy_room(AtlasImage* room, AtlasImage* atlas, const int rx, const int ry)
+{
+    const SDL_Surface* buffer = graphics.backBuffer;
+
+    room->width = SCREEN_WIDTH_PIXELS;
+    room->height = SCREEN_HEIGHT_PIXELS;
+    room->pixels.resize(SCREEN_WIDTH_PIXELS * SCREEN_HEIGHT_PIXELS);
+
+    for (int y = 0; y < SCREEN_HEIGHT_PIXELS; y++)
+    {
+        const Uint32* row = (const Uint32*) ((const Uint8*) buffer->pixels + y * buffer->pitch);
+        Uint32* atlas_row = &atlas->pixels[
+            (ry * SCREEN_HEIGHT_PIXELS + y) * atlas->width + rx * SCREEN_WIDTH_PIXELS
+        ];
+
+        SDL_memcpy(&room->pixels[y * SCREEN_WIDTH_PIXELS], row, SCREEN_WIDTH_PIXELS * sizeof(Uint32));
+        SDL_memcpy(atlas_row, row, SCREEN_WIDTH_PIXELS * sizeof(Uint32));
+    }
+}
+
+static void start_level(void)
+{
+    /* Same as script.startgamemode(22), minus the music and fading */
+    cl.findstartpoint();
+    game.gamestate = GAMEMODE;
+    script.hardreset();
+    game.customstart();
+    map.custommodeforreal = true;
+    map.custommode = true;
+
+    if (obj.entities.empty())
+    {
+        obj.createentity(game.savex, game.savey, 0, 0);
+    }
+    map.resetplayer();
+}
+
+bool ROOMATLAS_render(const char* level)
+{
+    std::string path = std::string("levels/") + level + ".vvvvvv";
+    const std::string dir = std::string("atlas/") + level + "/";
+    std::vector<SDL_Thread*> workers;
+    const int num_workers = SDL_max(SDL_GetCPUCount(), 1);
+
+    if (!cl.load(path))
+    {
+        vlog_error("Could not load %s", path.c_str());
+        return false;
+    }
+    if (!FILESYSTEM_createDirectory(dir.c_str()))
+    {
+        vlog_error("Could not create %s", dir.c_str());
+        return false;
+    }
+
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    taken = SDL_CreateCond();
+    finishing = false;
+    failures = 0;
+    for (int i = 0; lock != NULL && wake != NULL && taken != NULL && i < num_workers; i++)
+    {
+        SDL_Thread* thread = SDL_CreateThread(worker_main, "RoomAtlas", NULL);
+        if (thread == NULL)
+        {
+            break;
+        }
+        workers.push_back(thread);
+    }
+    if (workers.empty())
+    {
+        vlog_error("Could not start room atlas threads: %s", SDL_GetError());
+        failures++;
+    }
+    else
+    {
+        start_level();
+
+        AtlasImage atlas;
+        atlas.path = dir + "atlas.png";
+        atlas.width = cl.mapwidth * SCREEN_WIDTH_PIXELS;
+        atlas.height = cl.mapheight * SCREEN_HEIGHT_PIXELS;
+        atlas.pixels.resize(atlas.width * atlas.height);
+
+        graphics.alpha = 1.0f;
+
+        for (int ry = 0; ry < cl.mapheight; ry++)
+        {
+            for (int rx = 0; rx < cl.mapwidth; rx++)
+            {
+                map.gotoroom(100 + rx, 100 + ry);
+
+                const int player = obj.getplayer();
+                if (INBOUNDS_VEC(player, obj.entities))
+                {
+                    obj.entities[player].invis = true;
+                }
+
+                draw_room();
+
+                AtlasImage room;
+                room.path = dir + help.String(rx) + "_" + help.String(ry) + ".png";
+                copy_room(&room, &atlas, rx, ry);
+                queue_image(room, workers.size() * 2);
+            }
+        }
+
+        queue_image(atlas, workers.size() * 2);
+
+        SDL_LockMutex(lock);
+        finishing = true;
+        SDL_CondBroadcast(wake);
+        SDL_UnlockMutex(lock);
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            SDL_WaitThread(workers[i], NULL);
+        }
+
+        vlog_info(
+            "Saved %i rooms of %s to %s",
+            cl.mapwidth * cl.mapheight,
+            level,
+            dir.c_str()
+        );
+    }
+
+    if (taken != NULL)
+    {
+        SDL_DestroyCond(taken);
+        taken = NULL;
+    }
+    if (wake != NULL)
+    {
+        SDL_DestroyCond(wake);
+        wake = NULL;
+    }
+    if (lock != NULL)
+    {
+        SDL_DestroyMutex(lock);
+        lock = NULL;
+    }
+
+    return failures == 0;
+}
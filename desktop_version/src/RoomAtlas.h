@@ -0,0 +1,11 @@
+#ifndef ROOMATLAS_H
+#define ROOMATLAS_H
+
+/* Loads levels/<level>.vvvvvv, draws every room with the normal game
+ * drawing code, and saves them as PNGs under atlas/<level>/ in the save
+ * directory: one per room, named <x>_<y>.png, plus atlas.png with the whole
+ * map. Encoding and saving happens on a pool of worker threads while the
+ * next rooms are drawn. Returns false if anything couldn't be saved. */
+bool ROOMATLAS_render(const char* level);
+
+#endif /* ROOMATLAS_H */
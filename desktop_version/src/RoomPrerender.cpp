@@ -0,0 +1,195 @@
+#include "RoomPrerender.h"
+
+#include <SDL.h>
+#include <deque>
+
+#include "Blit.h"
+#include "Constants.h"
+#include "Vlogging.h"
+
+static SDL_Thread* worker = NULL;
+static SDL_mutex* lock = NULL;
+static SDL_cond* wake = NULL;
+static SDL_cond* idle = NULL;
+
+/* Everything below is guarded by lock */
+static std::deque<PrerenderedRoom> pending;
+static std::deque<PrerenderedRoom> finished;
+static bool busy = false;
+static bool quitting = false;
+
+static bool draw_room(const PrerenderedRoom& room)
+{
+    for (int j = 0; j < SCREEN_HEIGHT_TILES; j++)
+    {
+        /* SDL_BlitSurface() isn't safe to call on a surface the main thread
+         * might be blitting too, so give up on anything the fast path can't
+         * do */
+        if (!BlitRow(
+            &room.cells[TILE_IDX(0, j)],
+            SCREEN_WIDTH_TILES,
+            8,
+            room.surface,
+            0,
+            j * 8
+        )) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int SDLCALL worker_main(void* unused)
+{
+    (void) unused;
+
+    SDL_LockMutex(lock);
+    while (true)
+    {
+        while (!quitting && pending.empty())
+        {
+            SDL_CondWait(wake, lock);
+        }
+        if (quitting)
+        {
+            break;
+        }
+
+        PrerenderedRoom room = pending.front();
+        pending.pop_front();
+        busy = true;
+        SDL_UnlockMutex(lock);
+
+        room.ok = draw_room(room);
+
+        SDL_LockMutex(lock);
+        busy = false;
+        finished.push_back(room);
+        SDL_CondBroadcast(idle);
+    }
+    SDL_UnlockMutex(lock);
+
+    return 0;
+}
+
+void PRERENDER_init(void)
+{
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    idle = SDL_CreateCond();
+    if (lock == NULL || wake == NULL || idle == NULL)
+    {
+        vlog_warn("Could not set up room prerendering: %s", SDL_GetError());
+        PRERENDER_quit();
+        return;
+    }
+
+    quitting = false;
+    worker = SDL_CreateThread(worker_main, "RoomPrerender", NULL);
+    if (worker == NULL)
+    {
+        vlog_warn("Could not start room prerendering thread: %s", SDL_GetError());
+        PRERENDER_quit();
+    }
+}
+
+void PRERENDER_quit(void)
+{
+    if (worker != NULL)
+    {
+        SDL_LockMutex(lock);
+        quitting = true;
+        SDL_CondSignal(wake);
+        SDL_UnlockMutex(lock);
+
+        SDL_WaitThread(worker, NULL);
+        worker = NULL;
+    }
+
+    PRERENDER_cancel();
+
+    if (idle != NULL)
+    {
+        SDL_DestroyCond(idle);
+        idle = NULL;
+    }
+    if (wake != NULL)
+    {
+        SDL_DestroyCond(wake);
+        wake = NULL;
+    }
+    if (lock != NULL)
+    {
+        SDL_DestroyMutex(lock);
+        lock = NULL;
+    }
+}
+
+bool PRERENDER_queue(const Uint64 key, const std::vector<SDL_Surface*>& cells, SDL_Surface* surface)
+{
+    if (worker == NULL
+    || surface == NULL
+    || cells.size() != SCREEN_WIDTH_TILES * SCREEN_HEIGHT_TILES)
+    {
+        return false;
+    }
+
+    PrerenderedRoom room;
+    room.key = key;
+    room.cells = cells;
+    room.surface = surface;
+    room.ok = false;
+
+    SDL_LockMutex(lock);
+    pending.push_back(room);
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+
+    return true;
+}
+
+bool PRERENDER_collect(PrerenderedRoom* room)
+{
+    bool collected = false;
+
+    if (lock == NULL)
+    {
+        return false;
+    }
+
+    SDL_LockMutex(lock);
+    if (!finished.empty())
+    {
+        *room = finished.front();
+        finished.pop_front();
+        collected = true;
+    }
+    SDL_UnlockMutex(lock);
+
+    return collected;
+}
+
+void PRERENDER_cancel(void)
+{
+    std::deque<PrerenderedRoom> dropped;
+
+    if (lock == NULL)
+    {
+        return;
+    }
+
+    SDL_LockMutex(lock);
+    while (busy)
+    {
+        SDL_CondWait(idle, lock);
+    }
+    dropped.swap(pending);
+    dropped.insert(dropped.end(), finished.begin(), finished.end());
+    finished.clear();
+    SDL_UnlockMutex(lock);
+
+    for (size_t i = 0; i < dropped.size(); i++)
+    {
+        SDL_FreeSurface(dropped[i].surface);
+    }
+}
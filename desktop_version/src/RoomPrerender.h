@@ -0,0 +1,39 @@
+#ifndef ROOMPRERENDER_H
+#define ROOMPRERENDER_H
+
+#include <SDL.h>
+#include <vector>
+
+/* Draws room foregrounds on a worker thread, so a room the player is about
+ * to walk into doesn't have to be drawn tile by tile on the frame they get
+ * there. The worker only ever blits, so it never touches anything but the
+ * surfaces it's handed. */
+
+struct PrerenderedRoom
+{
+    Uint64 key;
+    /* One tile surface per cell, in TILE_IDX() order, NULL if empty */
+    std::vector<SDL_Surface*> cells;
+    SDL_Surface* surface;
+    bool ok;
+};
+
+void PRERENDER_init(void);
+
+void PRERENDER_quit(void);
+
+/* Queues cells to be drawn onto surface, which has to be blank. The worker
+ * owns surface until it comes back out of PRERENDER_collect(). Returns false
+ * if it can't be queued, in which case surface is still the caller's. */
+bool PRERENDER_queue(Uint64 key, const std::vector<SDL_Surface*>& cells, SDL_Surface* surface);
+
+/* Takes one finished room, if there is one. If ok is false, the worker
+ * couldn't draw it and surface should just be freed. */
+bool PRERENDER_collect(PrerenderedRoom* room);
+
+/* Throws away everything queued or finished, and waits for the worker to
+ * let go of the room it's on. Call this before freeing any tile surface
+ * that might have been queued. */
+void PRERENDER_cancel(void);
+
+#endif /* ROOMPRERENDER_H */
@@ -3,9 +3,11 @@
 
 #include <SDL.h>
 
+#include "Capture.h"
 #include "FileSystemUtils.h"
 #include "Game.h"
 #include "GraphicsUtil.h"
+#include "ShmExport.h"
 #include "Vlogging.h"
 
 void ScreenSettings_default(struct ScreenSettings* _this)
@@ -25,6 +27,9 @@ void Screen::init(const struct ScreenSettings* settings)
     m_renderer = NULL;
     m_screenTexture = NULL;
     m_screen = NULL;
+    m_screenUploaded = false;
+    m_screenDirty = false;
+    keepframe = false;
     isWindowed = !settings->fullscreen;
     scalingMode = settings->scalingMode;
     isFiltered = settings->linearFilter;
@@ -131,8 +136,8 @@ void Screen::LoadIcon(void)
 
 void Screen::ResizeScreen(int x, int y)
 {
-    static int resX = 320;
-    static int resY = 240;
+    static ENGINE_LOCAL int resX = 320;
+    static ENGINE_LOCAL int resY = 240;
     if (x != -1 && y != -1)
     {
         // This is a user resize!
@@ -255,6 +260,27 @@ void Screen::GetWindowSize(int* x, int* y)
     SDL_GetRendererOutputSize(m_renderer, x, y);
 }
 
+/* Whether blitting buffer onto the whole of m_screen would just copy it */
+static bool can_upload_directly(SDL_Surface* buffer, const SDL_Rect* rect)
+{
+    SDL_BlendMode blend;
+    Uint32 key;
+    Uint8 alpha;
+    Uint8 r, g, b;
+
+    return rect == NULL
+    && buffer->w == 320
+    && buffer->h == 240
+    && buffer->format->format == SDL_PIXELFORMAT_ARGB8888
+    && SDL_GetSurfaceBlendMode(buffer, &blend) == 0
+    && blend == SDL_BLENDMODE_NONE
+    && SDL_GetColorKey(buffer, &key) != 0
+    && SDL_GetSurfaceAlphaMod(buffer, &alpha) == 0
+    && alpha == 255
+    && SDL_GetSurfaceColorMod(buffer, &r, &g, &b) == 0
+    && r == 255 && g == 255 && b == 255;
+}
+
 void Screen::UpdateScreen(SDL_Surface* buffer, SDL_Rect* rect )
 {
     if((buffer == NULL) && (m_screen == NULL) )
@@ -267,9 +293,30 @@ void Screen::UpdateScreen(SDL_Surface* buffer, SDL_Rect* rect )
         buffer = ApplyFilter(buffer);
     }
 
-
-    ClearSurface(m_screen);
-    BlitSurfaceStandard(buffer,NULL,m_screen,rect);
+    if (!keepframe && can_upload_directly(buffer, rect))
+    {
+        /* Skip m_screen entirely, saving a clear and a full-screen copy
+         * every frame */
+        SDL_UpdateTexture(
+            m_screenTexture,
+            NULL,
+            buffer->pixels,
+            buffer->pitch
+        );
+        CAPTURE_video(buffer->pixels, buffer->pitch);
+        SHMEXPORT_frame(buffer->pixels, buffer->pitch);
+        m_screenUploaded = true;
+    }
+    else
+    {
+        if (m_screenDirty)
+        {
+            ClearSurface(m_screen);
+        }
+        BlitSurfaceStandard(buffer,NULL,m_screen,rect);
+        m_screenUploaded = false;
+        m_screenDirty = true;
+    }
 
     if(badSignalEffect)
     {
@@ -297,12 +344,17 @@ void Screen::FlipScreen(const bool flipmode)
         flip_flags = SDL_FLIP_NONE;
     }
 
-    SDL_UpdateTexture(
-        m_screenTexture,
-        NULL,
-        m_screen->pixels,
-        m_screen->pitch
-    );
+    if (!m_screenUploaded)
+    {
+        SDL_UpdateTexture(
+            m_screenTexture,
+            NULL,
+            m_screen->pixels,
+            m_screen->pitch
+        );
+        CAPTURE_video(m_screen->pixels, m_screen->pitch);
+        SHMEXPORT_frame(m_screen->pixels, m_screen->pitch);
+    }
     SDL_RenderCopyEx(
         m_renderer,
         m_screenTexture,
@@ -313,8 +365,15 @@ void Screen::FlipScreen(const bool flipmode)
         flip_flags
     );
     SDL_RenderPresent(m_renderer);
+    CAPTURE_present();
+    SHMEXPORT_present();
     SDL_RenderClear(m_renderer);
-    ClearSurface(m_screen);
+    if (m_screenDirty)
+    {
+        ClearSurface(m_screen);
+        m_screenDirty = false;
+    }
+    m_screenUploaded = false;
 }
 
 void Screen::toggleFullScreen(void)
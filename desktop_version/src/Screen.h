@@ -3,6 +3,7 @@
 
 #include <SDL.h>
 
+#include "EngineLocal.h"
 #include "ScreenSettings.h"
 
 class Screen
@@ -36,15 +37,26 @@ public:
     bool badSignalEffect;
     int scalingMode;
     bool vsync;
+    /* Always draw into m_screen, even when the buffer could go straight to
+     * the texture, so the whole frame can be read back from m_screen until
+     * the next UpdateScreen(). Set by libvvvvvv, which never presents. */
+    bool keepframe;
 
     SDL_Window *m_window;
     SDL_Renderer *m_renderer;
     SDL_Texture *m_screenTexture;
     SDL_Surface* m_screen;
+
+private:
+    /* Whether this frame went straight to m_screenTexture, bypassing
+     * m_screen */
+    bool m_screenUploaded;
+    /* Whether m_screen has anything on it that needs clearing */
+    bool m_screenDirty;
 };
 
 #ifndef GAMESCREEN_DEFINITION
-extern Screen gameScreen;
+extern ENGINE_LOCAL Screen& gameScreen;
 #endif
 
 #endif /* SCREEN_H */
@@ -42,8 +42,8 @@ void scriptclass::clearcustom(void)
     customscripts.clear();
 }
 
-static bool argexists[NUM_SCRIPT_ARGS];
-static std::string raw_words[NUM_SCRIPT_ARGS];
+static ENGINE_LOCAL bool argexists[NUM_SCRIPT_ARGS];
+static ENGINE_LOCAL std::string raw_words[NUM_SCRIPT_ARGS];
 
 void scriptclass::tokenize( const std::string& t )
 {
@@ -2365,7 +2365,7 @@ void scriptclass::run(void)
 
 void scriptclass::resetgametomenu(void)
 {
-    obj.entities.clear();
+    obj.removeallentities();
     game.quittomenu();
     game.createmenu(Menu::gameover);
 }
@@ -6,6 +6,8 @@
 
 #include <SDL.h>
 
+#include "EngineLocal.h"
+
 #define filllines(lines) commands.insert(commands.end(), lines, lines + SDL_arraysize(lines))
 
 
@@ -72,7 +74,7 @@ public:
 };
 
 #ifndef SCRIPT_DEFINITION
-extern scriptclass script;
+extern ENGINE_LOCAL scriptclass& script;
 #endif
 
 #endif /* SCRIPT_H */
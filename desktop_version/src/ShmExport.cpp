@@ -0,0 +1,209 @@
+#include "ShmExport.h"
+
+#include <SDL.h>
+#include <string>
+
+#include "Entity.h"
+#include "Game.h"
+#include "UtilityClass.h"
+#include "Vlogging.h"
+
+#if !defined(__EMSCRIPTEN__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__unix__))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_SHM
+#endif
+
+static ShmExport* shared = NULL;
+static std::string shared_name;
+static Uint64 frame_count = 0;
+/* The slot being filled in this frame, or -1 if nothing's been drawn yet */
+static int staged_slot = -1;
+/* From SHMEXPORT_setstate(), for the next SHMEXPORT_present() */
+static ShmExportState next_state;
+static bool has_next_state = false;
+
+static void begin_slot(const int slot)
+{
+    ShmExportSlot* data = &shared->slots[slot];
+
+    data->sequence++;
+    SDL_MemoryBarrierRelease();
+}
+
+static void end_slot(const int slot)
+{
+    ShmExportSlot* data = &shared->slots[slot];
+
+    SDL_MemoryBarrierRelease();
+    data->sequence++;
+    SDL_MemoryBarrierRelease();
+    shared->latest = slot;
+}
+
+bool SHMEXPORT_init(const char* name)
+{
+#ifdef HAVE_SHM
+    const int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd == -1)
+    {
+        vlog_error("Could not open shared memory %s.", name);
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(ShmExport)) != 0)
+    {
+        vlog_error("Could not resize shared memory %s.", name);
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, sizeof(ShmExport), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        vlog_error("Could not map shared memory %s.", name);
+        shm_unlink(name);
+        return false;
+    }
+
+    shared = (ShmExport*) mapping;
+    shared_name = name;
+    SDL_memset(shared, 0, sizeof(ShmExport));
+    shared->version = SHMEXPORT_VERSION;
+    shared->width = SCREEN_WIDTH_PIXELS;
+    shared->height = SCREEN_HEIGHT_PIXELS;
+    shared->latest = SHMEXPORT_SLOTS;
+    SDL_MemoryBarrierRelease();
+    /* Last, so readers know everything else is set up */
+    shared->magic = SHMEXPORT_MAGIC;
+
+    frame_count = 0;
+    staged_slot = -1;
+    has_next_state = false;
+
+    vlog_info("Exporting frames to shared memory %s", name);
+    return true;
+#else
+    vlog_error("Shared memory export isn't supported on this platform.");
+    return false;
+#endif
+}
+
+void SHMEXPORT_quit(void)
+{
+#ifdef HAVE_SHM
+    if (shared == NULL)
+    {
+        return;
+    }
+
+    /* Tell anyone still attached that we've gone */
+    shared->magic = 0;
+    munmap(shared, sizeof(ShmExport));
+    shm_unlink(shared_name.c_str());
+    shared = NULL;
+    shared_name.clear();
+#endif
+}
+
+void SHMEXPORT_frame(const void* pixels, const int pitch)
+{
+    if (shared == NULL)
+    {
+        return;
+    }
+
+    if (staged_slot == -1)
+    {
+        staged_slot = shared->latest == SHMEXPORT_SLOTS ? 0 : (shared->latest + 1) % SHMEXPORT_SLOTS;
+        begin_slot(staged_slot);
+    }
+
+    Uint32* dst = shared->slots[staged_slot].pixels;
+    const Uint8* row = (const Uint8*) pixels;
+    for (int y = 0; y < SCREEN_HEIGHT_PIXELS; ++y)
+    {
+        SDL_memcpy(dst + y * SCREEN_WIDTH_PIXELS, row, SCREEN_WIDTH_PIXELS * sizeof(Uint32));
+        row += pitch;
+    }
+}
+
+void SHMEXPORT_present(void)
+{
+    if (shared == NULL || staged_slot == -1)
+    {
+        return;
+    }
+
+    ShmExportSlot* data = &shared->slots[staged_slot];
+    ShmExportState state;
+
+    if (has_next_state)
+    {
+        state = next_state;
+        has_next_state = false;
+    }
+    else
+    {
+        SHMEXPORT_capture(&state);
+    }
+
+    data->frame = ++frame_count;
+    data->roomx = state.roomx;
+    data->roomy = state.roomy;
+    data->has_player = state.has_player;
+    data->player_x = state.player_x;
+    data->player_y = state.player_y;
+    data->player_vx = state.player_vx;
+    data->player_vy = state.player_vy;
+    data->deathcounts = state.deathcounts;
+    data->hours = state.hours;
+    data->minutes = state.minutes;
+    data->seconds = state.seconds;
+    data->frames = state.frames;
+
+    end_slot(staged_slot);
+    staged_slot = -1;
+}
+
+void SHMEXPORT_capture(ShmExportState* state)
+{
+    const int i = obj.getplayer();
+
+    SDL_zerop(state);
+    if (shared == NULL)
+    {
+        return;
+    }
+
+    state->roomx = game.roomx;
+    state->roomy = game.roomy;
+    state->has_player = INBOUNDS_VEC(i, obj.entities);
+    if (state->has_player)
+    {
+        state->player_x = obj.entities[i].xp;
+        state->player_y = obj.entities[i].yp;
+        state->player_vx = obj.entities[i].vx;
+        state->player_vy = obj.entities[i].vy;
+    }
+    state->deathcounts = game.deathcounts;
+    state->hours = game.hours;
+    state->minutes = game.minutes;
+    state->seconds = game.seconds;
+    state->frames = game.frames;
+}
+
+void SHMEXPORT_setstate(const ShmExportState* state)
+{
+    if (shared == NULL)
+    {
+        return;
+    }
+
+    next_state = *state;
+    has_next_state = true;
+}
@@ -0,0 +1,91 @@
+#ifndef SHMEXPORT_H
+#define SHMEXPORT_H
+
+#include <SDL.h>
+
+#include "Constants.h"
+
+/* Publishes the latest frame and some game state to a POSIX shared memory
+ * segment, for overlays and other tools running on the same machine.
+ *
+ * The segment is one ShmExport. The game writes to the three slots in turn
+ * and sets latest once a slot is complete, so a slot is only written again
+ * two frames after it was published. Readers can read straight out of the
+ * slot at latest, then check that its sequence didn't change while they did
+ * (and isn't odd, which means it's being written); if it did, they fell too
+ * far behind and should just try again with the new latest. */
+
+#define SHMEXPORT_MAGIC 0x56565656 /* "VVVV" */
+#define SHMEXPORT_VERSION 1
+#define SHMEXPORT_SLOTS 3
+
+struct ShmExportSlot
+{
+    volatile Uint32 sequence;
+    Uint32 has_player;
+    /* Counts presented frames, starting from 1 */
+    Uint64 frame;
+    Sint32 roomx;
+    Sint32 roomy;
+    Sint32 player_x;
+    Sint32 player_y;
+    float player_vx;
+    float player_vy;
+    Sint32 deathcounts;
+    Sint32 hours;
+    Sint32 minutes;
+    Sint32 seconds;
+    Sint32 frames;
+    Sint32 reserved;
+    /* ARGB8888, before scaling */
+    Uint32 pixels[SCREEN_WIDTH_PIXELS * SCREEN_HEIGHT_PIXELS];
+};
+
+struct ShmExport
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 width;
+    Uint32 height;
+    /* Index of the newest complete slot, or SHMEXPORT_SLOTS if there isn't
+     * one yet */
+    volatile Uint32 latest;
+    Uint32 reserved[3];
+    struct ShmExportSlot slots[SHMEXPORT_SLOTS];
+};
+
+/* The game state published with each frame */
+struct ShmExportState
+{
+    Uint32 has_player;
+    Sint32 roomx;
+    Sint32 roomy;
+    Sint32 player_x;
+    Sint32 player_y;
+    float player_vx;
+    float player_vy;
+    Sint32 deathcounts;
+    Sint32 hours;
+    Sint32 minutes;
+    Sint32 seconds;
+    Sint32 frames;
+};
+
+/* name is passed to shm_open(), so it should look like "/vvvvvv" */
+bool SHMEXPORT_init(const char* name);
+
+void SHMEXPORT_quit(void);
+
+/* Same contract as CAPTURE_video() and CAPTURE_present() */
+void SHMEXPORT_frame(const void* pixels, int pitch);
+
+void SHMEXPORT_present(void);
+
+/* For frames presented later than they're drawn: capture the state when the
+ * frame's drawn, and set it just before it's presented, so the next
+ * SHMEXPORT_present() publishes that instead of the state at the time. */
+void SHMEXPORT_capture(struct ShmExportState* state);
+
+void SHMEXPORT_setstate(const struct ShmExportState* state);
+
+#endif /* SHMEXPORT_H */
@@ -10,6 +10,7 @@
 towerclass::towerclass(void)
 {
     minitowermode = false;
+    version = 0;
     //We create a blank map
     SDL_memset(contents, 0, sizeof(contents));
     SDL_memset(back, 0, sizeof(back));
@@ -187,6 +188,8 @@ void towerclass::loadminitower1(void)
 
     SDL_memcpy(minitower, tmap, sizeof(minitower));
 #endif
+
+    version++;
 }
 
 void towerclass::loadminitower2(void)
@@ -297,6 +300,8 @@ void towerclass::loadminitower2(void)
 
     SDL_memcpy(minitower, tmap, sizeof(minitower));
 #endif
+
+    version++;
 }
 
 
@@ -1137,4 +1142,6 @@ void towerclass::loadmap(void)
 
     SDL_memcpy(contents, tmap, sizeof(contents));
 #endif
+
+    version++;
 }
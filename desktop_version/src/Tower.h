@@ -25,6 +25,10 @@ public:
     short minitower[40 * 100];
 
     bool minitowermode;
+
+    /* Bumped whenever the map data above changes, so anything drawn from it
+     * and cached knows to redraw */
+    int version;
 };
 
 
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "EngineLocal.h"
+
 int ss_toi(const std::string& str);
 
 bool next_split(
@@ -114,7 +116,7 @@ public:
 };
 
 #ifndef HELP_DEFINITION
-extern UtilityClass help;
+extern ENGINE_LOCAL UtilityClass& help;
 #endif
 
 #endif /* UTILITYCLASS_H */
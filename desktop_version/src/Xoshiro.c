@@ -1,5 +1,7 @@
 #include <stdint.h>
 
+#include "EngineLocal.h"
+
 /* Implements the xoshiro128+ PRNG. */
 
 static uint32_t rotl(const uint32_t x, const int k)
@@ -7,7 +9,11 @@ static uint32_t rotl(const uint32_t x, const int k)
     return (x << k) | (x >> (32 - k));
 }
 
-static uint32_t s[4];
+static ENGINE_LOCAL uint32_t s[4];
+
+/* fRandom()'s own generator in libvvvvvv, so it doesn't move this one.
+ * libvvvvvv seeds it on every start; until then it's as if seeded with 1. */
+static ENGINE_LOCAL uint32_t fs[4] = {0xc6277c7fUL, 0x351c78cdUL, 0xa94b31d1UL, 0x05f3cfc1UL};
 
 static uint32_t splitmix32(uint32_t* x)
 {
@@ -18,6 +24,7 @@ static uint32_t splitmix32(uint32_t* x)
 }
 
 static void seed(
+    uint32_t s[4],
     const uint32_t s0,
     const uint32_t s1,
     const uint32_t s2,
@@ -29,7 +36,7 @@ static void seed(
     s[3] = s3;
 }
 
-uint32_t xoshiro_next(void)
+static uint32_t next(uint32_t s[4])
 {
     const uint32_t result = s[0] + s[3];
 
@@ -47,16 +54,56 @@ uint32_t xoshiro_next(void)
     return result;
 }
 
-void xoshiro_seed(uint32_t s)
+uint32_t xoshiro_next(void)
+{
+    return next(s);
+}
+
+static void seed_from(uint32_t s[4], uint32_t x)
+{
+    const uint32_t s0 = splitmix32(&x);
+    const uint32_t s1 = splitmix32(&x);
+    const uint32_t s2 = splitmix32(&x);
+    const uint32_t s3 = splitmix32(&x);
+    seed(s, s0, s1, s2, s3);
+}
+
+void xoshiro_seed(uint32_t x)
+{
+    seed_from(s, x);
+}
+
+void xoshiro_get_state(uint32_t state[4])
+{
+    seed(state, s[0], s[1], s[2], s[3]);
+}
+
+void xoshiro_set_state(const uint32_t state[4])
 {
-    const uint32_t s0 = splitmix32(&s);
-    const uint32_t s1 = splitmix32(&s);
-    const uint32_t s2 = splitmix32(&s);
-    const uint32_t s3 = splitmix32(&s);
-    seed(s0, s1, s2, s3);
+    seed(s, state[0], state[1], state[2], state[3]);
 }
 
 float xoshiro_rand(void)
 {
     return ((float) xoshiro_next()) / ((float) UINT32_MAX);
 }
+
+void xoshiro_fseed(uint32_t x)
+{
+    seed_from(fs, x);
+}
+
+void xoshiro_fget_state(uint32_t state[4])
+{
+    seed(state, fs[0], fs[1], fs[2], fs[3]);
+}
+
+void xoshiro_fset_state(const uint32_t state[4])
+{
+    seed(fs, state[0], state[1], state[2], state[3]);
+}
+
+float xoshiro_frand(void)
+{
+    return ((float) next(fs)) / ((float) UINT32_MAX);
+}
@@ -12,8 +12,23 @@ void xoshiro_seed(uint32_t s);
 
 uint32_t xoshiro_next(void);
 
+void xoshiro_get_state(uint32_t state[4]);
+
+void xoshiro_set_state(const uint32_t state[4]);
+
 float xoshiro_rand(void);
 
+/* A second, separate generator, behind fRandom() in libvvvvvv. Unlike
+ * rand(), which the executable still uses, its state can be read back and
+ * put back. It's not the same sequence as rand(). */
+void xoshiro_fseed(uint32_t s);
+
+void xoshiro_fget_state(uint32_t state[4]);
+
+void xoshiro_fset_state(const uint32_t state[4]);
+
+float xoshiro_frand(void);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -4,48 +4,32 @@
 #include <emscripten/html5.h>
 #endif
 
+#include "Capture.h"
 #include "CustomLevels.h"
-#include "DeferCallbacks.h"
+#include "DrawList.h"
 #include "Editor.h"
+#include "Engine.h"
 #include "Enums.h"
 #include "Entity.h"
 #include "Exit.h"
 #include "FileSystemUtils.h"
+#include "ForkServer.h"
 #include "Game.h"
 #include "Graphics.h"
-#include "Input.h"
 #include "KeyPoll.h"
-#include "Logic.h"
+#include "LevelWatch.h"
 #include "Map.h"
 #include "Music.h"
 #include "Network.h"
-#include "preloader.h"
-#include "Render.h"
-#include "RenderFixed.h"
+#include "PlaytestFifo.h"
+#include "RoomAtlas.h"
+#include "RoomPrerender.h"
 #include "Screen.h"
 #include "Script.h"
+#include "ShmExport.h"
 #include "UtilityClass.h"
 #include "Vlogging.h"
 
-scriptclass script;
-
-#ifndef NO_CUSTOM_LEVELS
-std::vector<CustomEntity> customentities;
-customlevelclass cl;
-# ifndef NO_EDITOR
-editorclass ed;
-# endif
-#endif
-
-UtilityClass help;
-Graphics graphics;
-musicclass music;
-Game game;
-KeyPoll key;
-mapclass map;
-entityclass obj;
-Screen gameScreen;
-
 static bool startinplaytest = false;
 static bool savefileplaytest = false;
 static int savex = 0;
@@ -55,182 +39,29 @@ static int savery = 0;
 static int savegc = 0;
 static int savemusic = 0;
 static std::string playassets;
+static int renderthreads = 1;
+static bool pipelinerender = false;
+static const char* capturepath = NULL;
+static const char* shmexportname = NULL;
+static const char* roomatlasname = NULL;
+static const char* forkserverpath = NULL;
+static const char* playtestfifopath = NULL;
+static bool hotreload = false;
 
 static std::string playtestname;
 
-static volatile Uint64 time_ = 0;
-static volatile Uint64 timePrev = 0;
-static volatile Uint32 accumulator = 0;
+static volatile Uint64& time_ = engine.time_;
+static volatile Uint64& timePrev = engine.timePrev;
+static volatile Uint32& accumulator = engine.accumulator;
 
 #ifndef __EMSCRIPTEN__
-static volatile Uint64 f_time = 0;
-static volatile Uint64 f_timePrev = 0;
-#endif
-
-enum FuncType
-{
-    Func_null,
-    Func_fixed,
-    Func_input,
-    Func_delta
-};
-
-struct ImplFunc
-{
-    enum FuncType type;
-    void (*func)(void);
-};
-
-static void runscript(void)
-{
-    script.run();
-}
-
-static void teleportermodeinput(void)
-{
-    if (game.useteleporter)
-    {
-        teleporterinput();
-    }
-    else
-    {
-        script.run();
-        gameinput();
-    }
-}
-
-/* Only gets used in EDITORMODE. I assume the compiler will optimize this away
- * if this is a NO_CUSTOM_LEVELS or NO_EDITOR build
- */
-static void flipmodeoff(void)
-{
-    graphics.flipmode = false;
-}
-
-static void focused_begin(void);
-static void focused_end(void);
-
-static const inline struct ImplFunc* get_gamestate_funcs(
-    const int gamestate,
-    int* num_implfuncs
-) {
-    switch (gamestate)
-    {
-
-#define FUNC_LIST_BEGIN(GAMESTATE) \
-    case GAMESTATE: \
-    { \
-        static const struct ImplFunc implfuncs[] = { \
-            {Func_fixed, focused_begin},
-
-#define FUNC_LIST_END \
-            {Func_fixed, focused_end} \
-        }; \
-        *num_implfuncs = SDL_arraysize(implfuncs); \
-        return implfuncs; \
-    }
-
-    FUNC_LIST_BEGIN(GAMEMODE)
-        {Func_fixed, runscript},
-        {Func_fixed, gamerenderfixed},
-        {Func_delta, gamerender},
-        {Func_input, gameinput},
-        {Func_fixed, gamelogic},
-    FUNC_LIST_END
-
-    FUNC_LIST_BEGIN(TITLEMODE)
-        {Func_input, titleinput},
-        {Func_fixed, titlerenderfixed},
-        {Func_delta, titlerender},
-        {Func_fixed, titlelogic},
-    FUNC_LIST_END
-
-    FUNC_LIST_BEGIN(MAPMODE)
-        {Func_fixed, maprenderfixed},
-        {Func_delta, maprender},
-        {Func_input, mapinput},
-        {Func_fixed, maplogic},
-    FUNC_LIST_END
-
-    FUNC_LIST_BEGIN(TELEPORTERMODE)
-        {Func_fixed, teleporterrenderfixed},
-        {Func_delta, teleporterrender},
-        {Func_input, teleportermodeinput},
-        {Func_fixed, maplogic},
-    FUNC_LIST_END
-
-    FUNC_LIST_BEGIN(GAMECOMPLETE)
-        {Func_fixed, gamecompleterenderfixed},
-        {Func_delta, gamecompleterender},
-        {Func_input, gamecompleteinput},
-        {Func_fixed, gamecompletelogic},
-    FUNC_LIST_END
-
-    FUNC_LIST_BEGIN(GAMECOMPLETE2)
-        {Func_delta, gamecompleterender2},
-        {Func_input, gamecompleteinput2},
-        {Func_fixed, gamecompletelogic2},
-    FUNC_LIST_END
-
-#if !defined(NO_CUSTOM_LEVELS) && !defined(NO_EDITOR)
-    FUNC_LIST_BEGIN(EDITORMODE)
-        {Func_fixed, flipmodeoff},
-        {Func_input, editorinput},
-        {Func_fixed, editorrenderfixed},
-        {Func_delta, editorrender},
-        {Func_fixed, editorlogic},
-    FUNC_LIST_END
+static volatile Uint64& f_time = engine.f_time;
+static volatile Uint64& f_timePrev = engine.f_timePrev;
 #endif
 
-    FUNC_LIST_BEGIN(PRELOADER)
-        {Func_input, preloaderinput},
-        {Func_fixed, preloaderrenderfixed},
-        {Func_delta, preloaderrender},
-    FUNC_LIST_END
-
-#undef FUNC_LIST_END
-#undef FUNC_LIST_BEGIN
-
-    }
-
-    SDL_assert(0 && "Invalid gamestate!");
-    return NULL;
-}
-
-enum IndexCode
-{
-    Index_none,
-    Index_end
-};
-
-static const struct ImplFunc* gamestate_funcs = NULL;
-static int num_gamestate_funcs = 0;
-static int gamestate_func_index = -1;
-
-static enum IndexCode increment_gamestate_func_index(void)
-{
-    gamestate_func_index++;
-
-    if (gamestate_func_index == num_gamestate_funcs)
-    {
-        /* Reached the end of current gamestate order.
-         * Re-fetch for new order if gamestate changed.
-         */
-        gamestate_funcs = get_gamestate_funcs(
-            game.gamestate,
-            &num_gamestate_funcs
-        );
-
-        /* Also run callbacks that were deferred to end of func sequence. */
-        DEFER_execute_callbacks();
-
-        gamestate_func_index = 0;
-
-        return Index_end;
-    }
-
-    return Index_none;
-}
+static const struct ImplFunc*& gamestate_funcs = engine.gamestate_funcs;
+static int& num_gamestate_funcs = engine.num_gamestate_funcs;
+static int& gamestate_func_index = engine.gamestate_func_index;
 
 static void unfocused_run(void);
 
@@ -246,7 +77,7 @@ static const struct ImplFunc unfocused_func_list[] = {
 };
 static const struct ImplFunc* unfocused_funcs = unfocused_func_list;
 static int num_unfocused_funcs = SDL_arraysize(unfocused_func_list);
-static int unfocused_func_index = 0; // This does not get incremented on start, do NOT use -1!
+static int& unfocused_func_index = engine.unfocused_func_index;
 
 static enum IndexCode increment_unfocused_func_index(void)
 {
@@ -262,10 +93,10 @@ static enum IndexCode increment_unfocused_func_index(void)
     return Index_none;
 }
 
-static const struct ImplFunc** active_funcs = NULL;
-static int* num_active_funcs = NULL;
-static int* active_func_index = NULL;
-static enum IndexCode (*increment_func_index)(void) = NULL;
+static const struct ImplFunc**& active_funcs = engine.active_funcs;
+static int*& num_active_funcs = engine.num_active_funcs;
+static int*& active_func_index = engine.active_func_index;
+static enum IndexCode (*&increment_func_index)(void) = engine.increment_func_index;
 
 enum LoopCode
 {
@@ -280,7 +111,7 @@ static enum LoopCode loop_assign_active_funcs(void)
         active_funcs = &gamestate_funcs;
         num_active_funcs = &num_gamestate_funcs;
         active_func_index = &gamestate_func_index;
-        increment_func_index = &increment_gamestate_func_index;
+        increment_func_index = &ENGINE_increment_gamestate_func_index;
     }
     else
     {
@@ -332,7 +163,7 @@ static enum LoopCode (*const meta_funcs[])(void) = {
     loop_run_active_funcs,
     loop_end
 };
-static int meta_func_index = 0;
+static int& meta_func_index = engine.meta_func_index;
 
 static void inline fixedloop(void)
 {
@@ -438,6 +269,60 @@ int main(int argc, char *argv[])
                 playassets = "levels/" + std::string(argv[i]) + ".vvvvvv";
             })
         }
+        else if (ARG("-renderthreads"))
+        {
+            ARG_INNER({
+                i++;
+                renderthreads = help.Int(argv[i]);
+            })
+        }
+        else if (ARG("-pipelinerender"))
+        {
+            pipelinerender = true;
+        }
+        else if (ARG("-capture"))
+        {
+            ARG_INNER({
+                i++;
+                capturepath = argv[i];
+            })
+        }
+        else if (ARG("-shmexport"))
+        {
+            ARG_INNER({
+                i++;
+                shmexportname = argv[i];
+            })
+        }
+        else if (ARG("-roomatlas"))
+        {
+            ARG_INNER({
+                i++;
+                roomatlasname = argv[i];
+            })
+        }
+        else if (ARG("-forkserver"))
+        {
+            ARG_INNER({
+                i++;
+                forkserverpath = argv[i];
+            })
+        }
+        else if (ARG("-playtestfifo"))
+        {
+            ARG_INNER({
+                i++;
+                playtestfifopath = argv[i];
+            })
+        }
+        else if (ARG("-hotreload"))
+        {
+            hotreload = true;
+        }
+        else if (ARG("-soundcache"))
+        {
+            music.sound_cache_file = true;
+        }
         else if (ARG("-nooutput"))
         {
             vlog_toggle_output(0);
@@ -475,6 +360,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (roomatlasname != NULL || forkserverpath != NULL)
+    {
+        /* Nothing gets shown, so don't open a real window */
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    }
+
     if(!FILESYSTEM_init(argv[0], baseDir, assetsPath))
     {
         vlog_error("Unable to initialize filesystem!");
@@ -532,6 +423,23 @@ int main(int argc, char *argv[])
 
 
     graphics.init();
+    PRERENDER_init();
+    /* The room atlas reads each frame back as soon as it's drawn */
+    DRAWLIST_init(renderthreads, pipelinerender && roomatlasname == NULL);
+
+    if (capturepath != NULL)
+    {
+        if (!CAPTURE_init(capturepath))
+        {
+            VVV_exit(1);
+        }
+        music.setcapture(true);
+    }
+
+    if (shmexportname != NULL && !SHMEXPORT_init(shmexportname))
+    {
+        VVV_exit(1);
+    }
 
     game.init();
 
@@ -619,30 +527,29 @@ int main(int argc, char *argv[])
     obj.init();
 
 #if !defined(NO_CUSTOM_LEVELS)
+    if (roomatlasname != NULL)
+    {
+        VVV_exit(ROOMATLAS_render(roomatlasname) ? 0 : 1);
+    }
+
+    if (forkserverpath != NULL)
+    {
+        FORKSERVER_run(forkserverpath);
+    }
+
+    if (playtestfifopath != NULL && !PLAYTESTFIFO_init(playtestfifopath))
+    {
+        VVV_exit(1);
+    }
+
+    if (hotreload && !LEVELWATCH_init())
+    {
+        VVV_exit(1);
+    }
+
     if (startinplaytest) {
-        game.levelpage = 0;
-        game.playcustomlevel = 0;
         game.playassets = playassets;
-        game.menustart = true;
-
-        LevelMetaData meta;
-        if (cl.getLevelMetaData(playtestname, meta)) {
-            cl.ListOfMetaData.clear();
-            cl.ListOfMetaData.push_back(meta);
-        } else {
-            cl.loadZips();
-            if (cl.getLevelMetaData(playtestname, meta)) {
-                cl.ListOfMetaData.clear();
-                cl.ListOfMetaData.push_back(meta);
-            } else {
-                vlog_error("Level not found");
-                VVV_exit(1);
-            }
-        }
 
-        game.loadcustomlevelstats();
-        game.customleveltitle=cl.ListOfMetaData[game.playcustomlevel].title;
-        game.customlevelfilename=cl.ListOfMetaData[game.playcustomlevel].filename;
         if (savefileplaytest) {
             game.playx = savex;
             game.playy = savey;
@@ -650,19 +557,18 @@ int main(int argc, char *argv[])
             game.playry = savery;
             game.playgc = savegc;
             game.playmusic = savemusic;
-            game.cliplaytest = true;
-            script.startgamemode(23);
-        } else {
-            script.startgamemode(22);
         }
 
-        graphics.fademode = 0;
+        if (!ENGINE_start_playtest(playtestname, savefileplaytest)) {
+            vlog_error("Level not found");
+            VVV_exit(1);
+        }
     }
 #endif
 
     key.isActive = true;
 
-    gamestate_funcs = get_gamestate_funcs(game.gamestate, &num_gamestate_funcs);
+    gamestate_funcs = ENGINE_get_gamestate_funcs(game.gamestate, &num_gamestate_funcs);
     loop_assign_active_funcs();
 
 #ifdef __EMSCRIPTEN__
@@ -697,12 +603,27 @@ int main(int argc, char *argv[])
 static void cleanup(void)
 {
     /* Order matters! */
-    game.savestatsandsettings();
+    if (roomatlasname == NULL && forkserverpath == NULL)
+    {
+        /* The room atlas and the fork server never open a real window, so
+         * don't save their window settings over the player's */
+        game.savestatsandsettings();
+    }
+    music.setcapture(false);
+    CAPTURE_quit();
+    SHMEXPORT_quit();
+#if !defined(NO_CUSTOM_LEVELS)
+    PLAYTESTFIFO_quit();
+    LEVELWATCH_quit();
+#endif
+    DRAWLIST_wait();
     gameScreen.destroy();
     graphics.grphx.destroy();
+    DRAWLIST_quit();
+    PRERENDER_quit();
     graphics.destroy_buffers();
     graphics.destroy();
-    music.destroy();
+    music.deinit();
     NETWORK_shutdown();
     SDL_Quit();
     FILESYSTEM_deinit();
@@ -755,9 +676,26 @@ static void inline deltaloop(void)
 
         if (implfunc->type == Func_delta && implfunc->func != NULL)
         {
+            /* Finish the last frame, if it was left drawing while this one's
+             * fixed steps ran */
+            bool pendingflipmode;
+            ShmExportState pendingexport;
+            const bool uploaded = graphics.uploadpendingframe(&pendingflipmode, &pendingexport);
+
             implfunc->func();
 
-            gameScreen.FlipScreen(graphics.flipmode);
+            /* Flip once per frame, whichever one ends up on screen: if this
+             * one was drawn straight away (e.g. the gamestate changed to
+             * one that doesn't pipeline), it replaces the last one */
+            if (!graphics.framepending)
+            {
+                gameScreen.FlipScreen(graphics.flipmode);
+            }
+            else if (uploaded)
+            {
+                SHMEXPORT_setstate(&pendingexport);
+                gameScreen.FlipScreen(pendingflipmode);
+            }
         }
     }
 }
@@ -772,6 +710,11 @@ static enum LoopCode loop_begin(void)
     // Update network per frame.
     NETWORK_update();
 
+#if !defined(NO_CUSTOM_LEVELS)
+    PLAYTESTFIFO_update();
+    LEVELWATCH_update();
+#endif
+
     return Loop_continue;
 }
 
@@ -794,18 +737,6 @@ static void unfocused_run(void)
 #endif
 }
 
-static void focused_begin(void)
-{
-    map.nexttowercolour_set = false;
-}
-
-static void focused_end(void)
-{
-    game.gameclock();
-    music.processmusic();
-    graphics.processfade();
-}
-
 static enum LoopCode loop_end(void)
 {
     //We did editorinput, now it's safe to turn this off
@@ -4,12 +4,12 @@
 #include "KeyPoll.h"
 #include "UtilityClass.h"
 
-static int pre_fakepercent=0, pre_transition=30;
-static bool pre_startgame=false;
-static int pre_darkcol=0, pre_lightcol=0, pre_curcol=0, pre_coltimer=0, pre_offset=0;
+static ENGINE_LOCAL int pre_fakepercent=0, pre_transition=30;
+static ENGINE_LOCAL bool pre_startgame=false;
+static ENGINE_LOCAL int pre_darkcol=0, pre_lightcol=0, pre_curcol=0, pre_coltimer=0, pre_offset=0;
 
-static int pre_frontrectx=30, pre_frontrecty=20, pre_frontrectw=260, pre_frontrecth=200;
-static int pre_temprectx=0, pre_temprecty=0, pre_temprectw=320, pre_temprecth=240;
+static ENGINE_LOCAL int pre_frontrectx=30, pre_frontrecty=20, pre_frontrectw=260, pre_frontrecth=200;
+static ENGINE_LOCAL int pre_temprectx=0, pre_temprecty=0, pre_temprectw=320, pre_temprecth=240;
 
 void preloaderinput(void)
 {